@@ -0,0 +1,90 @@
+/*
+ * Links shared by the tests.
+ *
+ * Like most links, their sync() never compacts the input buffer, so the
+ * streams on top of them have to make room themselves.
+ */
+#ifndef TESTS_LINKS_H
+#define TESTS_LINKS_H
+#include <string>
+#include "uio.hpp"
+
+// bytes flushed to the output are appended to the wire, and sync moves as
+// many as fit from the wire to the input
+class loopback : public uio::iostream {
+public:
+    std::string wire;
+
+    explicit loopback(size_t icap, size_t ocap = 4096) {
+        _ibuf.setbuf(_ib, icap);
+        _obuf.setbuf(_ob, ocap);
+    }
+
+    virtual uio::ostream& flush() {
+        wire.append(_obuf.gptr(), _obuf.in_avail());
+        _obuf.gbump(_obuf.in_avail());
+        return *this;
+    }
+
+    virtual uio::istream& sync() {
+        wire.erase(0, _ibuf.sputn(wire.data(), wire.size()));
+        return *this;
+    }
+
+private:
+    char _ib[4096];
+    char _ob[4096];
+};
+
+// one end of a pair of links: what one end flushes, the other syncs
+class pipe_end : public uio::iostream {
+public:
+    std::string wire; // bytes on their way to this end
+
+    explicit pipe_end(size_t icap, size_t ocap = 4096) {
+        _ibuf.setbuf(_ib, icap);
+        _obuf.setbuf(_ob, ocap);
+        _peer = this;
+    }
+
+    void connect(pipe_end& peer) {
+        _peer = &peer;
+        peer._peer = this;
+    }
+
+    virtual uio::ostream& flush() {
+        _peer->wire.append(_obuf.gptr(), _obuf.in_avail());
+        _obuf.gbump(_obuf.in_avail());
+        return *this;
+    }
+
+    virtual uio::istream& sync() {
+        wire.erase(0, _ibuf.sputn(wire.data(), wire.size()));
+        return *this;
+    }
+
+private:
+    pipe_end* _peer;
+    char _ib[4096];
+    char _ob[4096];
+};
+
+// an input whose sync moves as many bytes as fit from the wire
+class feed : public uio::istream {
+public:
+    std::string wire;
+
+    explicit feed(size_t capacity) {
+        _ibuf.setbuf(_buf, capacity);
+    }
+
+    virtual uio::istream& sync() {
+        wire.erase(0, _ibuf.sputn(wire.data(), wire.size()));
+        return *this;
+    }
+
+private:
+    char _buf[4096];
+};
+
+#endif // TESTS_LINKS_H
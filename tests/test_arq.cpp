@@ -0,0 +1,185 @@
+/*
+ * Tests for uio::arq_iostream over a simulated lossy link.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_arq.cpp -o test_arq && ./test_arq
+ */
+#include <assert.h>
+#include <string.h>
+#include <deque>
+#include <string>
+#include "uio_arq.hpp"
+
+static unsigned seed = 1;
+
+static unsigned rnd() {
+    seed = seed * 1103515245u + 12345u;
+    return (seed >> 8) & 0xFFFF;
+}
+
+// one direction of the link: frames arrive lat ticks after they are sent,
+// unless they are dropped or corrupted (loss and corrupt are per mille)
+struct channel {
+    struct packet {
+        uint32_t at;
+        std::string bytes;
+    };
+    std::deque<packet> q;
+    uint32_t lat;
+    unsigned loss;
+    unsigned corrupt;
+};
+
+static uint32_t now;
+
+// splits its output into frames at the closing flags
+class lossy_link : public uio::iostream {
+public:
+    lossy_link(channel* out, channel* in) : _out(out), _in(in) {
+        _ibuf.setbuf(_ib, sizeof(_ib));
+        _obuf.setbuf(_ob, sizeof(_ob));
+    }
+
+    virtual uio::ostream& flush() {
+        const char* p = _obuf.gptr();
+        for (size_t i = 0; i < _obuf.in_avail(); ++i) {
+            if (p[i] == 0x7E && _frame.size() > 1) {
+                _frame += p[i];
+                emit();
+            } else if (p[i] == 0x7E) {
+                _frame.assign(1, p[i]);
+            } else {
+                _frame += p[i];
+            }
+        }
+        _obuf.gbump(_obuf.in_avail());
+        return *this;
+    }
+
+    virtual uio::istream& sync() {
+        _ibuf.compact();
+        while (!_in->q.empty() && _in->q.front().at <= now) {
+            std::string& b = _in->q.front().bytes;
+            if ((size_t) (_ibuf.epptr() - _ibuf.pptr()) < b.size()) {
+                break;
+            }
+            _ibuf.sputn(b.data(), b.size());
+            _in->q.pop_front();
+        }
+        return *this;
+    }
+
+private:
+    void emit() {
+        channel::packet pkt;
+        pkt.at = now + _out->lat;
+        pkt.bytes.swap(_frame);
+        if (rnd() % 1000 < _out->loss) {
+            return;
+        }
+        if (rnd() % 1000 < _out->corrupt) {
+            pkt.bytes[1 + rnd() % (pkt.bytes.size() - 2)] ^= 0x10;
+        }
+        _out->q.push_back(pkt);
+    }
+
+    channel* _out;
+    channel* _in;
+    std::string _frame;
+    char _ib[4096];
+    char _ob[4096];
+};
+
+struct endpoint {
+    lossy_link link;
+    uio::arq_iostream arq;
+    char ib[2048];
+    char ob[8192];
+    char reorder[16 * 128];
+    size_t sent;
+    size_t received;
+
+    endpoint(channel* out, channel* in, size_t rcap)
+        : link(out, in), arq(link, 128, 50), sent(0), received(0) {
+        arq.setbuf(ib, sizeof(ib), ob, sizeof(ob), reorder, rcap);
+    }
+
+    // write the next bytes of a pattern (64 per tick), and check what was
+    // received
+    void step(size_t total, bool poll) {
+        if (poll) {
+            arq.poll(now);
+        }
+        uio::streambuf& o = arq.obuf();
+        size_t k = uio::min(uio::min(total - sent, (size_t) 64),
+            (size_t) (o.epptr() - o.pptr()));
+        for (size_t i = 0; i < k; ++i) {
+            o.pptr()[i] = (char) ((sent + i) * 7 + 1);
+        }
+        o.pbump(k);
+        sent += k;
+        if (k) {
+            arq.flush();
+        }
+        arq.sync();
+        uio::streambuf& in = arq.ibuf();
+        for (size_t i = 0; i < in.in_avail(); ++i) {
+            assert(in.gptr()[i] == (char) ((received + i) * 7 + 1));
+        }
+        received += in.in_avail();
+        in.gbump(in.in_avail());
+    }
+};
+
+// send total bytes each way; returns when both ends have everything
+static void exchange(endpoint& a, endpoint& b, size_t total,
+    uint32_t period) {
+    for (now = 0; now < 1000000; ++now) {
+        bool poll = now % period == 0;
+        a.step(total, poll);
+        b.step(total, poll);
+        if (a.received == total && b.received == total
+            && !a.arq.inflight() && !b.arq.inflight()) {
+            return;
+        }
+    }
+    assert(false);
+}
+
+// data arrives intact and in order over a link that drops and corrupts
+// frames in both directions
+static void test_loss() {
+    channel ab = { std::deque<channel::packet>(), 10, 100, 50 };
+    channel ba = { std::deque<channel::packet>(), 10, 100, 50 };
+    endpoint a(&ab, &ba, sizeof(a.reorder));
+    endpoint b(&ba, &ab, sizeof(b.reorder));
+    exchange(a, b, 1 << 16, 1);
+    assert(a.arq.retransmits() && b.arq.retransmits());
+}
+
+// frames sent by flush between polls, which are seldom, are not resent on
+// a clean link
+static void test_no_spurious_retransmits() {
+    channel ab = { std::deque<channel::packet>(), 20, 0, 0 };
+    channel ba = { std::deque<channel::packet>(), 20, 0, 0 };
+    endpoint a(&ab, &ba, sizeof(a.reorder));
+    endpoint b(&ba, &ab, sizeof(b.reorder));
+    exchange(a, b, 1 << 16, 50);
+    assert(!a.arq.retransmits() && !b.arq.retransmits());
+}
+
+// a reorder buffer with no room for a frame still makes progress
+static void test_small_reorder_buffer() {
+    channel ab = { std::deque<channel::packet>(), 10, 100, 0 };
+    channel ba = { std::deque<channel::packet>(), 10, 100, 0 };
+    endpoint a(&ab, &ba, 16);
+    endpoint b(&ba, &ab, 16);
+    exchange(a, b, 1 << 14, 1);
+}
+
+int main() {
+    test_loss();
+    test_no_spurious_retransmits();
+    test_small_reorder_buffer();
+    return 0;
+}
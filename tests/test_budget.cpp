@@ -0,0 +1,86 @@
+/*
+ * Tests for uio::budget and the streams that draw from it.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_budget.cpp -o test_budget && ./test_budget
+ */
+#include <assert.h>
+#include <string.h>
+#include <string>
+#include "uio_budget.hpp"
+
+// sends its output to a string by dumping the output buffer
+class wire_ostream : public uio::budget_ostream {
+public:
+    std::string wire;
+
+    virtual uio::ostream& flush() {
+        char* s = (char*) _obuf.dump();
+        wire.append(s, _obuf.size());
+        return *this;
+    }
+};
+
+// output that has been flushed is not sent again when the buffer grows
+static void test_grow_after_flush() {
+    static char arena[1024];
+    uio::budget b;
+    b.setbuf(arena, sizeof(arena), 32);
+    wire_ostream out;
+    assert(out.attach(&b, 32, 64));
+    const char* first = "01234567890123456789";
+    const char* second = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMN";
+    out.write(first, strlen(first));
+    out.flush();
+    out.write(second, strlen(second));
+    out.flush();
+    assert(out.wire == std::string(first) + second);
+    assert(!out._oerror._flags.overflow);
+}
+
+// a stream that has been flushed is shrunk, and released once idle
+static void test_reclaim_after_flush() {
+    static char arena[1024];
+    uio::budget b;
+    b.setbuf(arena, sizeof(arena), 32);
+    wire_ostream eager;
+    wire_ostream lazy;
+    assert(eager.attach(&b, 32, 64));
+    assert(lazy.attach(&b, 32, 64, true));
+    char data[40];
+    memset(data, 'x', sizeof(data));
+    eager.write(data, sizeof(data));
+    lazy.write(data, sizeof(data));
+    assert(b.in_use() == 128);
+    eager.flush();
+    lazy.flush();
+    assert(b.reclaim() == 64);
+    assert(b.in_use() == 64);
+    assert(b.reclaim(100, 10) == 32);
+    assert(b.in_use() == 32);
+    assert(eager.wire.size() == 40 && lazy.wire.size() == 40);
+}
+
+// bytes that have already been flushed do not count towards the fill level
+static void test_tune_after_flush() {
+    static char arena[1024];
+    uio::budget b;
+    b.setbuf(arena, sizeof(arena), 32);
+    wire_ostream out;
+    assert(out.attach(&b, 32, 256));
+    char data[40];
+    memset(data, 'x', sizeof(data));
+    out.write(data, sizeof(data));
+    out.flush();
+    b.tune();
+    assert(out.suggested() == 64);
+    b.tune();
+    assert(out.suggested() == 32);
+}
+
+int main() {
+    test_grow_after_flush();
+    test_reclaim_after_flush();
+    test_tune_after_flush();
+    return 0;
+}
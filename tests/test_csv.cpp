@@ -0,0 +1,52 @@
+/*
+ * Tests for uio::csv_reader.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_csv.cpp -o test_csv && ./test_csv
+ */
+#include <assert.h>
+#include <string.h>
+#include "uio_csv.hpp"
+#include "links.hpp"
+
+// fields that cross the end of the buffer are completed
+static void test_fields_cross_buffer_end() {
+    feed link(48);
+    uio::csv_reader reader(link);
+    for (int i = 0; i < 20; ++i) {
+        link.wire += "alpha,\"be,ta\",gamma\r\n";
+    }
+    uio::csv_field f;
+    int got = 0;
+    for (int i = 0; i < 200 && got < 60; ++i) {
+        if (reader.next(&f)) {
+            const char* want[] = { "alpha", "be,ta", "gamma" };
+            const char* w = want[got % 3];
+            assert(f.len == strlen(w) && !memcmp(f.data, w, f.len));
+            assert(f.last == (got % 3 == 2));
+            ++got;
+        }
+    }
+    assert(got == 60);
+    assert(!link._ierror._flags.overflow);
+}
+
+// a field that does not fit in the buffer is returned in pieces
+static void test_oversized_field() {
+    feed link(16);
+    uio::csv_reader reader(link);
+    link.wire = "a field longer than the buffer,b\n";
+    uio::csv_field f;
+    bool got = false;
+    for (int i = 0; i < 10 && !got; ++i) {
+        got = reader.next(&f);
+    }
+    assert(got && f.len == 16 && !f.last);
+    assert(link._ierror._flags.overflow);
+}
+
+int main() {
+    test_fields_cross_buffer_end();
+    test_oversized_field();
+    return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * Tests for uio::datagram_iostream.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_datagram.cpp -o test_datagram && ./test_datagram
+ */
+#define UIO_DATAGRAM_QUEUE 4
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <deque>
+#include <string>
+#include "uio_datagram.hpp"
+
+// datagrams are queued in memory; the transport can be told to refuse
+// them
+class mailbox : public uio::datagram_iostream {
+public:
+    std::deque<std::string> inbox;
+    std::deque<std::string> outbox;
+    bool refuse;
+
+    mailbox(size_t mtu, size_t icap, size_t ocap) : datagram_iostream(mtu) {
+        setbuf(_ib, icap, _ob, ocap);
+        refuse = false;
+    }
+
+    std::string message() {
+        const char* msg;
+        size_t len;
+        assert(get_message(&msg, &len));
+        return std::string(msg, len);
+    }
+
+protected:
+    virtual bool send_datagram(const char* s, size_t n) {
+        if (refuse) {
+            return false;
+        }
+        outbox.push_back(std::string(s, n));
+        return true;
+    }
+
+    virtual bool recv_datagram(char* buf, size_t cap, size_t* len) {
+        if (inbox.empty()) {
+            return false;
+        }
+        std::string& d = inbox.front();
+        *len = d.size();
+        memcpy(buf, d.data(), d.size() < cap ? d.size() : cap);
+        inbox.pop_front();
+        return true;
+    }
+
+private:
+    char _ib[256];
+    char _ob[256];
+};
+
+// each committed message is sent as one datagram, and an open one is not
+static void test_send() {
+    mailbox m(16, 64, 64);
+    m.write("one", 3);
+    assert(m.commit());
+    assert(m.commit()); // an empty message
+    m.write("three", 5);
+    assert(m.commit());
+    m.write("open", 4);
+    m.flush();
+    assert(m.outbox.size() == 3);
+    assert(m.outbox[0] == "one" && m.outbox[1].empty());
+    assert(m.outbox[2] == "three");
+    m.write("ed", 2);
+    assert(m.commit());
+    m.flush();
+    assert(m.outbox.size() == 4 && m.outbox[3] == "opened");
+}
+
+// a message over the MTU stays open, and a refused message is kept
+static void test_send_errors() {
+    mailbox m(8, 64, 64);
+    m.write("0123456789", 10);
+    assert(!m.commit() && m._oerror._flags.overflow);
+
+    mailbox n(8, 64, 64);
+    n.refuse = true;
+    n.write("kept", 4);
+    assert(n.commit());
+    n.flush();
+    assert(n.outbox.empty());
+    n.refuse = false;
+    n.flush();
+    assert(n.outbox.size() == 1 && n.outbox[0] == "kept");
+}
+
+// a full queue of messages is flushed to make room, and the output buffer
+// is reused
+static void test_send_many() {
+    mailbox m(16, 64, 24);
+    std::deque<std::string> sent;
+    for (int i = 0; i < 50; ++i) {
+        char msg[16];
+        int n = sprintf(msg, "msg %d", i);
+        m.write(msg, n);
+        assert(m.commit());
+        sent.push_back(msg);
+        if (i % 3 == 2) {
+            m.flush();
+        }
+    }
+    m.flush();
+    assert(m.outbox == sent);
+    assert(!m._oerror._flags.overflow);
+}
+
+// received messages keep their boundaries while the side index wraps and
+// the input buffer is compacted
+static void test_receive() {
+    mailbox m(16, 40, 64);
+    std::deque<std::string> sent;
+    for (int i = 0; i < 50; ++i) {
+        char msg[16];
+        int n = sprintf(msg, "%.*s", i % 12, "abcdefghijkl");
+        m.inbox.push_back(std::string(msg, n));
+        sent.push_back(std::string(msg, n));
+    }
+    for (int i = 0; i < 50; ++i) {
+        assert(m.message() == sent[i]);
+    }
+    const char* msg;
+    size_t len;
+    assert(!m.get_message(&msg, &len));
+    assert(m.dropped() == 0);
+}
+
+// a datagram over the MTU is dropped and counted
+static void test_receive_oversized() {
+    mailbox m(8, 64, 64);
+    m.inbox.push_back("short");
+    m.inbox.push_back("much too long");
+    m.inbox.push_back("fine");
+    assert(m.message() == "short");
+    assert(m.message() == "fine");
+    assert(m.dropped() == 1 && m._ierror._flags.overflow);
+}
+
+int main() {
+    test_send();
+    test_send_errors();
+    test_send_many();
+    test_receive();
+    test_receive_oversized();
+    return 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * Tests for uio::dma_istream and uio::dma_ostream on uio::sim_dma.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_dma.cpp -o test_dma -pthread && ./test_dma
+ */
+#include <assert.h>
+#include <string.h>
+#include <string>
+#include "uio_dma.hpp"
+
+// a transmitting peripheral that takes every byte it is given
+class sink : public uio::sim_peripheral {
+public:
+    std::string wire;
+
+    virtual size_t transfer(char* mem, size_t n) {
+        wire.append(mem, n);
+        return n;
+    }
+};
+
+// a receiving peripheral that hands out the bytes of a string
+class source : public uio::sim_peripheral {
+public:
+    std::string wire;
+
+    virtual size_t transfer(char* mem, size_t n) {
+        n = n < wire.size() ? n : wire.size();
+        memcpy(mem, wire.data(), n);
+        wire.erase(0, n);
+        return n;
+    }
+};
+
+// the channel stops its helper thread before it is destroyed
+static void test_destroy_while_running() {
+    sink tx;
+    source rx;
+    rx.wire = std::string(1000, 'x');
+    char ib[64];
+    char ob[64];
+    {
+        uio::sim_dma rx_ch(rx, 4);
+        uio::sim_dma tx_ch(tx, 4);
+        uio::dma_istream in(rx_ch, 16);
+        uio::dma_ostream out(tx_ch);
+        in.setbuf(ib, sizeof(ib));
+        out.setbuf(ob, sizeof(ob));
+        assert(rx_ch.run(1000) && tx_ch.run(1000));
+        in.sync();
+        out.write("hello", 5);
+        out.flush();
+    }
+}
+
+// bytes written while a transfer is in flight do not run into the end of
+// the buffer
+static void test_write_during_transfer() {
+    sink tx;
+    uio::sim_dma ch(tx, 64); // finishes each transfer in one step
+    char ob[32];
+    uio::dma_ostream out(ch);
+    out.setbuf(ob, sizeof(ob));
+    std::string sent;
+    for (int i = 0; i < 20; ++i) {
+        char msg[8];
+        memset(msg, 'a' + i, sizeof(msg));
+        out.write(msg, sizeof(msg));
+        sent.append(msg, sizeof(msg));
+        out.flush();
+        ch.step();
+    }
+    out.flush();
+    ch.step();
+    out.flush();
+    assert(!out.busy());
+    assert(tx.wire == sent);
+    assert(!out._oerror._flags.overflow);
+}
+
+int main() {
+    test_destroy_while_running();
+    test_write_during_transfer();
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Tests for uio::fec_ostream and uio::fec_istream.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_fec.cpp -o test_fec && ./test_fec
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "uio_fec.hpp"
+#include "links.hpp"
+
+static void receive(uio::fec_istream& in, std::string* got) {
+    in.sync();
+    uio::streambuf& sb = in.ibuf();
+    got->append(sb.gptr(), sb.in_avail());
+    sb.gbump(sb.in_avail());
+}
+
+// blocks that cross the end of the link's input buffer are completed
+static void test_blocks_cross_buffer_end() {
+    loopback link(200); // a block is 120 bytes
+    char ob[64];
+    char ib[128];
+    char scratch[2 * 16];
+    uio::fec_ostream out(link, 4, 2, 16);
+    uio::fec_istream in(link, 4, 2, 16);
+    out.setbuf(ob, sizeof(ob));
+    in.setbuf(ib, sizeof(ib), scratch);
+
+    std::string sent;
+    std::string got;
+    for (int i = 0; i < 20; ++i) {
+        char msg[32];
+        int n = sprintf(msg, "message %d;", i);
+        out.write(msg, n);
+        out.flush();
+        sent.append(msg, n);
+    }
+    for (int i = 0; i < 100 && got.size() < sent.size(); ++i) {
+        receive(in, &got);
+    }
+    assert(got == sent);
+    assert(in.errors() == 0);
+}
+
+// rows that are corrupted on the link are repaired
+static void test_repair() {
+    loopback link(512);
+    char ob[64];
+    char ib[128];
+    char scratch[2 * 16];
+    uio::fec_ostream out(link, 4, 2, 16);
+    uio::fec_istream in(link, 4, 2, 16);
+    out.setbuf(ob, sizeof(ob));
+    in.setbuf(ib, sizeof(ib), scratch);
+
+    const char* msg = "a message that is spread over rows";
+    out.write(msg, strlen(msg));
+    out.flush();
+    link.wire[3] ^= 0x55;       // row 0
+    link.wire[20 * 3 + 7] ^= 1; // row 3
+    std::string got;
+    receive(in, &got);
+    assert(got == msg);
+    assert(in.repaired() == 1);
+}
+
+int main() {
+    test_blocks_cross_buffer_end();
+    test_repair();
+    return 0;
+}
@@ -0,0 +1,63 @@
+/*
+ * Tests for uio::hdlc_ostream and uio::hdlc_deframer.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_hdlc.cpp -o test_hdlc && ./test_hdlc
+ */
+#include <assert.h>
+#include <string.h>
+#include "uio_hdlc.hpp"
+#include "links.hpp"
+
+static void send(loopback& link, const char* s) {
+    char buf[64];
+    uio::hdlc_ostream out(link);
+    out.setbuf(buf, sizeof(buf));
+    out.write(s, strlen(s)).flush();
+    assert(!out._oerror._flags.overflow);
+}
+
+// frames that cross the end of the link's input buffer are completed
+static void test_frames_cross_buffer_end() {
+    const char* payload = "0123456789abcdefgh"; // 22 bytes framed
+    loopback link(32);
+    uio::hdlc_deframer deframer(link);
+    for (int i = 0; i < 10; ++i) {
+        send(link, payload);
+    }
+    const char* frame;
+    size_t len;
+    int got = 0;
+    for (int i = 0; i < 100 && got < 10; ++i) {
+        if (deframer.next(&frame, &len)) {
+            assert(len == strlen(payload));
+            assert(memcmp(frame, payload, len) == 0);
+            ++got;
+        }
+    }
+    assert(got == 10);
+    assert(deframer.errors() == 0);
+}
+
+// a frame that does not fit in the link's input buffer is dropped
+static void test_oversized_frame() {
+    loopback link(32);
+    uio::hdlc_deframer deframer(link);
+    send(link, "this payload is far too long for the buffer");
+    send(link, "short");
+    const char* frame;
+    size_t len;
+    bool got = false;
+    for (int i = 0; i < 10 && !got; ++i) {
+        got = deframer.next(&frame, &len);
+    }
+    assert(got && len == 5 && memcmp(frame, "short", 5) == 0);
+    assert(deframer.errors() == 1);
+    assert(link._ierror._flags.overflow);
+}
+
+int main() {
+    test_frames_cross_buffer_end();
+    test_oversized_frame();
+    return 0;
+}
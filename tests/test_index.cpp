@@ -0,0 +1,147 @@
+/*
+ * Tests for uio::indexed_ostream and uio::indexed_istream.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_index.cpp -o test_index && ./test_index
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "uio_index.hpp"
+
+// the three files of a capture, in memory
+struct capture {
+    std::string files[3];
+};
+
+// writes a capture; the next write to file fail_file stops after fail_after
+// bytes
+class memory_ostream : public uio::indexed_ostream {
+public:
+    int fail_file;
+    size_t fail_after;
+
+    memory_ostream(capture& c, uint32_t t0, uint32_t width)
+        : indexed_ostream(t0, width), _c(c) {
+        fail_file = -1;
+        fail_after = 0;
+    }
+
+protected:
+    virtual bool write_at(uio::index_file f, const char* s, size_t n,
+        uint64_t offset) {
+        std::string& file = _c.files[f];
+        bool fail = (int) f == fail_file;
+        size_t m = fail && fail_after < n ? fail_after : n;
+        fail_file = fail ? -1 : fail_file;
+        if (file.size() < offset + m) {
+            file.resize(offset + m);
+        }
+        file.replace(offset, m, s, m);
+        return m == n;
+    }
+
+private:
+    capture& _c;
+};
+
+class memory_istream : public uio::indexed_istream {
+public:
+    memory_istream(capture& c, uint32_t t0, uint32_t width)
+        : indexed_istream(t0, width), _c(c) {}
+
+protected:
+    virtual size_t read_at(uio::index_file f, char* s, size_t n,
+        uint64_t offset) {
+        const std::string& file = _c.files[f];
+        if (offset >= file.size()) {
+            return 0;
+        }
+        return file.copy(s, n, offset);
+    }
+
+private:
+    capture& _c;
+};
+
+static void write_records(memory_ostream& out, int from, int to) {
+    for (int i = from; i < to; ++i) {
+        char msg[32];
+        out.stamp(100 + 10 * i);
+        out.write(msg, sprintf(msg, "<record %d>", i));
+        out.flush();
+    }
+}
+
+static std::string read_record(memory_istream& in) {
+    uio::streambuf& sb = in.ibuf();
+    const char* end = (const char*) memchr(sb.gptr(), '>', sb.in_avail());
+    assert(end);
+    return std::string(sb.gptr(), end + 1 - sb.gptr());
+}
+
+// records are found by number and by time
+static void test_seek() {
+    capture c;
+    char ob[64];
+    char ib[64];
+    memory_ostream out(c, 100, 25);
+    out.setbuf(ob, sizeof(ob));
+    write_records(out, 0, 20);
+    assert(out.records() == 20);
+    assert(c.files[uio::RECORD_INDEX].size() == 20 * 8);
+
+    memory_istream in(c, 100, 25);
+    in.setbuf(ib, sizeof(ib));
+    assert(in.seek_record(13) && read_record(in) == "<record 13>");
+    assert(in.seek_record(0) && read_record(in) == "<record 0>");
+    assert(!in.seek_record(20));
+    // bucket 3 is [175, 200), so its first record is at 180
+    assert(in.seek_time(190) && read_record(in) == "<record 8>");
+    assert(!in.seek_time(100 + 25 * 20));
+}
+
+// a write that fails part-way is redone in place, so the files stay
+// aligned
+static void test_partial_write() {
+    capture c;
+    char ob[64];
+    char ib[64];
+    memory_ostream out(c, 100, 25);
+    out.setbuf(ob, sizeof(ob));
+    write_records(out, 0, 3);
+
+    out.fail_file = uio::RECORD_INDEX;
+    out.fail_after = 3;
+    write_records(out, 3, 4);
+    assert(out._oerror._flags.overflow && out.records() == 3);
+    out.fail_file = uio::DATA_FILE;
+    out.fail_after = 5;
+    write_records(out, 4, 5); // indexes record 3, then fails
+    assert(out.records() == 4);
+    out.flush();
+    out.fail_file = uio::TIME_INDEX;
+    out.fail_after = 2;
+    write_records(out, 5, 6);
+    assert(out.records() == 5);
+    out.flush();
+    write_records(out, 6, 10);
+    assert(out.records() == 10);
+    assert(c.files[uio::RECORD_INDEX].size() == 10 * 8);
+
+    memory_istream in(c, 100, 25);
+    in.setbuf(ib, sizeof(ib));
+    for (int i = 0; i < 10; ++i) {
+        char msg[32];
+        sprintf(msg, "<record %d>", i);
+        assert(in.seek_record(i) && read_record(in) == msg);
+    }
+    assert(in.seek_time(160) && read_record(in) == "<record 5>");
+}
+
+int main() {
+    test_seek();
+    test_partial_write();
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * Tests for the iterator and range adapters.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_iterator.cpp -o test_iterator && ./test_iterator
+ *
+ * Build with -std=c++20 to also test the ranges support.
+ */
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+#include <iterator>
+#include <string>
+#include "uio_iterator.hpp"
+#include "links.hpp"
+
+static const char text[] = "the quick brown fox jumps over the lazy dog";
+
+// a segment is the buffered input, and reading it does not consume it
+static void test_segment() {
+    feed in(16);
+    in.wire = text;
+    in.sync();
+    uio::input_segment s = uio::segment(in);
+    assert(s.size() == 16 && s.data() == in.ibuf().gptr());
+    assert(std::string(s.begin(), s.end()) == std::string(text, 16));
+    assert(std::count(s.begin(), s.end(), 'o') == 1);
+    assert(in.ibuf().in_avail() == 16);
+    in.ibuf().gbump(16);
+    assert(uio::segment(in).empty());
+}
+
+// the iterator reads across syncs until the input runs out
+static void test_iterator() {
+    feed in(5);
+    in.wire = text;
+    uio::istream_iterator first(in);
+    uio::istream_iterator last;
+    assert(first != last && *first == 't');
+    assert(*first++ == 't' && *first == 'h');
+    std::string s(first, last);
+    assert(s == text + 1);
+    assert(first == last);
+
+    feed empty(5);
+    assert(uio::istream_iterator(empty) == last);
+}
+
+// a range-based for loop reads the whole stream
+static void test_range() {
+    feed in(7);
+    in.wire = text;
+    std::string s;
+    uio::input_range r(in);
+    for (uio::istream_iterator it = r.begin(); it != r.end(); ++it) {
+        s += *it;
+    }
+    assert(s == text);
+}
+
+// copy and find work a segment at a time and stop where they should
+static void test_algorithms() {
+    using std::copy;
+    using std::find;
+    feed in(6);
+    in.wire = text;
+    uio::istream_iterator last;
+    uio::istream_iterator it = find(uio::istream_iterator(in), last, 'j');
+    assert(it != last && *it == 'j');
+    assert(find(it, last, 'j') == it);
+    char out[64];
+    char* end = copy(it, last, out);
+    assert(std::string(out, end) == strchr(text, 'j'));
+
+    feed again(6);
+    again.wire = text;
+    std::string s;
+    copy(uio::istream_iterator(again), last, std::back_inserter(s));
+    assert(s == text);
+    assert(find(uio::istream_iterator(again), last, 'x') == last);
+    assert(find(uio::istream_iterator(again), last, 0x100 + 't') == last);
+}
+
+#if __cplusplus >= 202002L
+// the views work with the ranges algorithms
+static void test_ranges() {
+    static_assert(std::ranges::contiguous_range<uio::input_segment>);
+    static_assert(std::ranges::input_range<uio::input_range>);
+    feed in(5);
+    in.wire = text;
+    in.sync();
+    assert(std::ranges::count(uio::segment(in), 'e') == 1);
+    assert(std::ranges::count(uio::input_range(in), 'o') == 4);
+}
+#endif
+
+int main() {
+    test_segment();
+    test_iterator();
+    test_range();
+    test_algorithms();
+#if __cplusplus >= 202002L
+    test_ranges();
+#endif
+    return 0;
+}
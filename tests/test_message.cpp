@@ -0,0 +1,56 @@
+/*
+ * Tests for uio::message_template.
+ *
+ * Build and run from the repository root:
+ *     c++ -std=c++11 -I. tests/test_message.cpp -o test_message && \
+ *         ./test_message
+ */
+#include <assert.h>
+#include <string.h>
+#include <string>
+#include "uio_message.hpp"
+#include "links.hpp"
+
+static constexpr auto check16 = uio::make_template("\x7E" "123456789\0\0");
+static constexpr auto check32 = uio::make_template("123456789\0\0\0\0");
+static constexpr auto status = uio::make_template("\x10\0\0\0\0\0\0\0");
+
+// fields are patched in place, in the requested byte order
+static void test_fields() {
+    loopback link(64);
+    static_assert(status.size() == 8, "size is the literal without its null");
+    bool put = (bool) status.put(link).be<1, 2>(0x1234)
+        .le<3, 3>(0xABCDEF).bytes<6, 2>("xy");
+    assert(put);
+    link.flush();
+    assert(link.wire == std::string("\x10\x12\x34\xEF\xCD\xAB" "xy", 8));
+}
+
+// the CRCs cover the requested bytes and are stored after them
+static void test_crcs() {
+    loopback link(64);
+    check16.put(link).crc16<10, 1>();
+    check32.put(link).crc32<9>();
+    link.flush();
+    assert(link.wire == std::string("\x7E" "123456789\x29\xB1"
+        "123456789\x26\x39\xF4\xCB", 25));
+}
+
+// a message that does not fit is not written, and its patch does nothing
+static void test_overflow() {
+    loopback link(64, 20);
+    assert(check16.put(link));
+    auto patch = check16.put(link);
+    assert(!patch);
+    patch.crc16<10>();
+    assert(link._oerror._flags.overflow);
+    link.flush();
+    assert(link.wire.size() == 12);
+}
+
+int main() {
+    test_fields();
+    test_crcs();
+    test_overflow();
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Tests for uio::modbus_master.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_modbus.cpp -o test_modbus && ./test_modbus
+ */
+#include <assert.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "uio_modbus.hpp"
+#include "links.hpp"
+
+// records each completion and the PDU it carried
+class recorder : public uio::modbus_master {
+public:
+    std::vector<uio::modbus_status> statuses;
+    std::vector<std::string> pdus;
+
+    recorder(uio::iostream& bus, uio::modbus_mode mode)
+        : modbus_master(bus, mode, 4) {}
+
+protected:
+    virtual void completed(uio::modbus_request& r, const char* pdu,
+        size_t len) {
+        statuses.push_back(r.status);
+        pdus.push_back(pdu ? std::string(pdu, len) : std::string());
+    }
+};
+
+static uio::modbus_request request(uint8_t slave, const char* pdu,
+    size_t len) {
+    uio::modbus_request r;
+    r.slave = slave;
+    r.pdu = pdu;
+    r.len = len;
+    r.timeout = 100;
+    return r;
+}
+
+// an RTU frame: the address, the PDU and the CRC
+static std::string rtu(uint8_t slave, const std::string& pdu) {
+    std::string s = std::string(1, (char) slave) + pdu;
+    uint16_t crc = uio::crc16_modbus(s.data(), s.size());
+    return s + (char) crc + (char) (crc >> 8);
+}
+
+// an ASCII frame: ':', the address, the PDU and the LRC in hex, and CR LF
+static std::string ascii(uint8_t slave, const std::string& pdu) {
+    static const char digits[] = "0123456789ABCDEF";
+    std::string b = std::string(1, (char) slave) + pdu;
+    unsigned char lrc = 0;
+    for (size_t i = 0; i < b.size(); ++i) {
+        lrc = (unsigned char) (lrc + (unsigned char) b[i]);
+    }
+    b += (char) -lrc;
+    std::string s = ":";
+    for (size_t i = 0; i < b.size(); ++i) {
+        s += digits[(unsigned char) b[i] >> 4];
+        s += digits[b[i] & 0xF];
+    }
+    return s + "\r\n";
+}
+
+static const std::string read_regs("\x03\x00\x00\x00\x02", 5);
+static const std::string regs("\x03\x04\x00\x0A\x01\x02", 6);
+
+// requests are framed with their CRC, and a response that arrives in
+// pieces is handed over once it is complete
+static void test_rtu() {
+    pipe_end master(64);
+    pipe_end slave(64);
+    master.connect(slave);
+    recorder m(master, uio::MODBUS_RTU);
+    uio::modbus_request r = request(1, read_regs.data(), read_regs.size());
+    assert(m.submit(&r));
+    m.poll(0);
+    assert(slave.wire == std::string("\x01\x03\x00\x00\x00\x02\xC4\x0B", 8));
+    assert(r.status == uio::MODBUS_SENT);
+
+    std::string response = rtu(1, regs);
+    master.wire = response.substr(0, 4);
+    m.poll(10);
+    assert(r.status == uio::MODBUS_SENT);
+    master.wire = response.substr(4);
+    m.poll(11);
+    assert(r.status == uio::MODBUS_DONE && m.pending() == 0);
+    assert(m.statuses.size() == 1 && m.pdus[0] == regs);
+}
+
+// the same request and response in ASCII mode
+static void test_ascii() {
+    pipe_end master(64);
+    pipe_end slave(64);
+    master.connect(slave);
+    recorder m(master, uio::MODBUS_ASCII);
+    uio::modbus_request r = request(1, read_regs.data(), read_regs.size());
+    assert(m.submit(&r));
+    m.poll(0);
+    assert(slave.wire == ":010300000002FA\r\n");
+    master.wire = "noise" + ascii(1, regs);
+    m.poll(10);
+    assert(r.status == uio::MODBUS_DONE && m.pdus[0] == regs);
+}
+
+// a bad CRC fails the request, silence times it out, and the next request
+// waits for the inter-frame gap
+static void test_errors() {
+    pipe_end master(64);
+    pipe_end slave(64);
+    master.connect(slave);
+    recorder m(master, uio::MODBUS_RTU);
+    uio::modbus_request a = request(1, read_regs.data(), read_regs.size());
+    uio::modbus_request b = request(2, read_regs.data(), read_regs.size());
+    uio::modbus_request c = request(3, read_regs.data(), read_regs.size());
+    assert(m.submit(&a) && m.submit(&b) && m.submit(&c));
+    m.poll(0);
+    std::string response = rtu(1, regs);
+    response[3] ^= 1;
+    master.wire = response;
+    m.poll(10);
+    assert(a.status == uio::MODBUS_CORRUPT);
+    assert(master._ierror._flags.corrupt);
+    assert(b.status == uio::MODBUS_QUEUED);
+    m.poll(14);
+    assert(b.status == uio::MODBUS_SENT);
+    m.poll(113);
+    assert(b.status == uio::MODBUS_SENT);
+    m.poll(114);
+    assert(b.status == uio::MODBUS_TIMEOUT && c.status == uio::MODBUS_SENT);
+    assert(slave.wire.size() == 3 * 8);
+}
+
+// a response from another slave is counted and skipped, and the request
+// still takes its own response
+static void test_unmatched() {
+    pipe_end master(64);
+    pipe_end slave(64);
+    master.connect(slave);
+    recorder m(master, uio::MODBUS_RTU);
+    uio::modbus_request r = request(2, read_regs.data(), read_regs.size());
+    assert(m.submit(&r));
+    m.poll(0);
+    master.wire = rtu(1, regs);
+    m.poll(10);
+    assert(m.unmatched() == 1 && r.status == uio::MODBUS_SENT);
+    master.wire = rtu(2, regs);
+    m.poll(20);
+    assert(r.status == uio::MODBUS_DONE && m.pdus[0] == regs);
+    assert(m.unmatched() == 1);
+}
+
+// a long run of transactions does not fill the input buffer
+static void test_many() {
+    pipe_end master(32);
+    pipe_end slave(64);
+    master.connect(slave);
+    recorder m(master, uio::MODBUS_RTU);
+    uint32_t now = 0;
+    for (int i = 0; i < 50; ++i) {
+        uio::modbus_request r = request(1 + i % 3, read_regs.data(),
+            read_regs.size());
+        assert(m.submit(&r));
+        m.poll(now += 10);
+        assert(r.status == uio::MODBUS_SENT);
+        master.wire = rtu(r.slave, regs);
+        m.poll(now += 10);
+        assert(r.status == uio::MODBUS_DONE);
+    }
+    assert(m.statuses.size() == 50 && m.unmatched() == 0);
+}
+
+int main() {
+    test_rtu();
+    test_ascii();
+    test_errors();
+    test_unmatched();
+    test_many();
+    return 0;
+}
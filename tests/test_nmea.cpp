@@ -0,0 +1,52 @@
+/*
+ * Tests for uio::nmea_parser.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_nmea.cpp -o test_nmea && ./test_nmea
+ */
+#include <assert.h>
+#include <string.h>
+#include "uio_nmea.hpp"
+#include "links.hpp"
+
+// sentences that cross the end of the buffer are completed
+static void test_sentences_cross_buffer_end() {
+    feed link(48);
+    uio::nmea_parser parser(link);
+    for (int i = 0; i < 10; ++i) {
+        link.wire += "$GPGGA,12,45678\r\n"; // 17 bytes
+    }
+    uio::nmea_sentence s;
+    int got = 0;
+    for (int i = 0; i < 100 && got < 10; ++i) {
+        if (parser.next(&s)) {
+            assert(s.is("GGA") && s.fields() == 3);
+            assert(s.field(2).len == 5 && !memcmp(s.field(2).data, "45678", 5));
+            ++got;
+        }
+    }
+    assert(got == 10);
+    assert(parser.errors() == 0);
+}
+
+// a line that does not fit in the buffer is dropped
+static void test_oversized_line() {
+    feed link(32);
+    uio::nmea_parser parser(link);
+    link.wire = "$GPTXT,this line is much longer than the buffer\r\n"
+        "$GPGGA,1\r\n";
+    uio::nmea_sentence s;
+    bool got = false;
+    for (int i = 0; i < 10 && !got; ++i) {
+        got = parser.next(&s);
+    }
+    assert(got && s.is("GGA"));
+    assert(parser.errors() == 1);
+    assert(link._ierror._flags.overflow);
+}
+
+int main() {
+    test_sentences_cross_buffer_end();
+    test_oversized_line();
+    return 0;
+}
@@ -0,0 +1,82 @@
+/*
+ * Tests for uio::ostream::printf.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_printf.cpp -o test_printf && ./test_printf
+ */
+#define UIO_PRINTF_CHUNK 16
+#include <assert.h>
+#include <string.h>
+#include <string>
+#include "uio.hpp"
+#include "links.hpp"
+
+// a stream that overrides write, so it formats through a stack chunk
+class writer : public uio::ostream {
+public:
+    std::string wire;
+
+    virtual uio::ostream& write(const char* s, size_t n) {
+        wire.append(s, n);
+        return *this;
+    }
+
+    virtual uio::ostream& flush() {
+        return *this;
+    }
+
+    virtual uio::ostream& vprintf(const char* format, va_list args) {
+        return vprintf_write(format, args);
+    }
+};
+
+// output is formatted into the buffer, without its null character
+static void test_in_place() {
+    loopback link(64, 16);
+    link.printf("T=%d", 42);
+    assert(link.obuf().in_avail() == 4 && link.wire.empty());
+    link.printf("%s", "0123456789A"); // leaves one byte for the null
+    assert(link.obuf().in_avail() == 15 && link.wire.empty());
+    link.flush();
+    assert(link.wire == "T=420123456789A");
+    assert(!link._oerror._flags.overflow);
+}
+
+// output that does not fit is formatted again after a flush
+static void test_continue_after_flush() {
+    loopback link(64, 16);
+    link.write("0123456789", 10);
+    link.printf("<%d,%d>", 123, -45);
+    assert(link.wire == "0123456789");
+    assert(link.obuf().in_avail() == 9);
+    link.flush();
+    assert(link.wire == "0123456789<123,-45>");
+    assert(!link._oerror._flags.overflow);
+}
+
+// output that does not fit an empty buffer is cut short
+static void test_overflow() {
+    loopback link(64, 16);
+    link.printf("%s-%s", "abcdefgh", "ijklmnop");
+    assert(link._oerror._flags.overflow);
+    link.flush();
+    assert(link.wire == "abcdefgh-ijklmn");
+}
+
+// streams that override write get the same output through a stack chunk
+static void test_write_chunk() {
+    writer w;
+    w.printf("%d %s", 7, "up");
+    assert(w.wire == "7 up" && !w._oerror._flags.overflow);
+    w.printf("%s", "0123456789abcdefgh");
+    assert(w.wire == "7 up0123456789abcde");
+    assert(w._oerror._flags.overflow);
+}
+
+int main() {
+    test_in_place();
+    test_continue_after_flush();
+    test_overflow();
+    test_write_chunk();
+    return 0;
+}
@@ -0,0 +1,160 @@
+/*
+ * Tests for uio::flight_recorder and uio::persistent_recorder.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_recorder.cpp -o test_recorder && ./test_recorder
+ */
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "uio_recorder.hpp"
+
+// the records in the ring, oldest first
+template <class R>
+static std::vector<std::string> records(const R& r) {
+    std::vector<std::string> v;
+    size_t cursor = 0;
+    char s[256];
+    size_t n;
+    while ((n = r.next(&cursor, s, sizeof(s)))) {
+        v.push_back(std::string(s, n));
+    }
+    return v;
+}
+
+// the ring keeps the most recent records, oldest first
+static void test_overwrite_oldest() {
+    char ring[64];
+    uio::flight_recorder r;
+    r.setbuf(ring, sizeof(ring));
+    std::vector<std::string> sent;
+    for (int i = 0; i < 30; ++i) {
+        char msg[16];
+        int n = sprintf(msg, "record %02d", i); // 11 bytes with its length
+        r.write(msg, n / 2);
+        r.write(msg + n / 2, n - n / 2);
+        r.flush();
+        sent.push_back(std::string(msg, n));
+    }
+    std::vector<std::string> got = records(r);
+    assert(r.records() == 5 && got.size() == 5);
+    for (size_t i = 0; i < got.size(); ++i) {
+        assert(got[i] == sent[sent.size() - 5 + i]);
+    }
+    assert(!r._oerror._flags.overflow);
+}
+
+// a record that does not fit in the ring is cut short
+static void test_oversized_record() {
+    char ring[16];
+    uio::flight_recorder r;
+    r.setbuf(ring, sizeof(ring));
+    r.write("old", 3).flush();
+    r.write("0123456789abcdefghij", 20).flush();
+    std::vector<std::string> got = records(r);
+    assert(got.size() == 1 && got[0] == "0123456789abcd");
+    assert(r._oerror._flags.overflow);
+}
+
+static unsigned lcg(unsigned* state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 16;
+}
+
+// recover the records from a copy of the recorder's memory
+static std::vector<std::string> recover(const char* mem, size_t size) {
+    static uint32_t copy[64];
+    assert(size <= sizeof(copy));
+    memcpy(copy, mem, size);
+    uio::persistent_recorder r;
+    r.setbuf((char*) copy, size);
+    return records(r);
+}
+
+// a copy of \a to with a random subset of the bytes in [begin, end) that
+// differ from \a from reverted, like a crash in the middle of a memcpy
+static std::string torn(const std::string& from, const std::string& to,
+    size_t begin, size_t end, unsigned* state) {
+    std::string s = to;
+    for (size_t i = begin; i < end; ++i) {
+        if (lcg(state) % 2) {
+            s[i] = from[i];
+        }
+    }
+    return s;
+}
+
+// a crash at any point while a record is written, as the ring wraps,
+// leaves either the records from before it or those from after it
+static void test_recover_torn_write() {
+    static uint32_t mem[64]; // a 16-byte header and a 240-byte ring
+    const size_t hdr = 16;
+    char* buf = (char*) mem;
+    uio::persistent_recorder r;
+    r.setbuf(buf, sizeof(mem));
+    unsigned state = 1;
+    for (int i = 0; i < 300; ++i) {
+        char msg[64];
+        size_t n = sprintf(msg, "record %d ", i);
+        size_t len = 1 + lcg(&state) % sizeof(msg);
+        while (n < len) {
+            msg[n++] = (char) lcg(&state);
+        }
+
+        std::string before(buf, sizeof(mem));
+        r.write(msg, n);
+        std::string written(buf, sizeof(mem));
+        r.flush();
+        std::string after(buf, sizeof(mem));
+        std::vector<std::string> now = records(r);
+        assert(now.back() == std::string(msg, n));
+
+        // the ring's header is moved (head_seq, then head, each stored in
+        // one go), the data is written, and then the record's header
+        std::vector<std::string> dropped(now.begin(), now.end() - 1);
+        std::string s = before;
+        memcpy(&s[12], &written[12], 4); // head_seq moved, head not yet
+        assert(recover(s.data(), s.size()) == dropped);
+        s = torn(before, written, hdr, sizeof(mem), &state);
+        assert(recover(s.data(), s.size()) == dropped);
+        s = torn(written, after, hdr, sizeof(mem), &state);
+        std::vector<std::string> got = recover(s.data(), s.size());
+        assert(got == dropped || got == now);
+        assert(recover(after.data(), after.size()) == now);
+    }
+}
+
+// a recovered ring carries on from the last record, and a record that was
+// still open at the crash is lost
+static void test_recover_and_continue() {
+    static uint32_t mem[32];
+    char* buf = (char*) mem;
+    {
+        uio::persistent_recorder r;
+        r.setbuf(buf, sizeof(mem));
+        r.write("one", 3).flush();
+        r.write("two", 3).flush();
+        r.write("open", 4); // crash before the flush
+    }
+    uio::persistent_recorder r;
+    r.setbuf(buf, sizeof(mem));
+    assert(r.records() == 2 && r.sequence() == 2);
+    r.write("three", 5).flush();
+    std::vector<std::string> got = recover(buf, sizeof(mem));
+    assert(got.size() == 3 && got[0] == "one" && got[2] == "three");
+
+    // a record whose data was damaged after it was committed ends the chain
+    buf[16 + 8 + 3 + 8] ^= 1; // the first byte of "two"
+    got = recover(buf, sizeof(mem));
+    assert(got.size() == 1 && got[0] == "one");
+}
+
+int main() {
+    test_overwrite_oldest();
+    test_oversized_record();
+    test_recover_torn_write();
+    test_recover_and_continue();
+    return 0;
+}
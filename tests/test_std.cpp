@@ -0,0 +1,107 @@
+/*
+ * Tests for uio::std_streambuf.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_std.cpp -o test_std && ./test_std
+ */
+#include <assert.h>
+#include <string.h>
+#include <istream>
+#include <ostream>
+#include <string>
+#include "uio_std.hpp"
+#include "links.hpp"
+
+// an output that never drains
+class stuck : public uio::ostream {
+public:
+    stuck() {
+        _obuf.setbuf(_buf, sizeof(_buf));
+    }
+
+    virtual uio::ostream& flush() {
+        return *this;
+    }
+
+private:
+    char _buf[8];
+};
+
+// formatted output goes to the uio buffer, and std::endl flushes it
+static void test_output() {
+    loopback link(64, 16);
+    uio::std_streambuf sb((uio::ostream&) link);
+    std::ostream out(&sb);
+    out << "T=" << 42 << std::endl;
+    assert(link.wire == "T=42\n");
+
+    // more than fits in the buffer is flushed as it fills
+    std::string line(100, '#');
+    out << line << ' ' << -7 << std::flush;
+    assert(link.wire == "T=42\n" + line + " -7");
+    assert(!link._oerror._flags.overflow);
+}
+
+// output that cannot be flushed fails the standard stream
+static void test_output_overflow() {
+    stuck link;
+    uio::std_streambuf sb(link);
+    std::ostream out(&sb);
+    out << "0123456789" << std::flush;
+    assert(out.bad());
+    assert(link._oerror._flags.overflow);
+    assert(link.obuf().in_avail() == 8);
+}
+
+// formatted input is parsed across syncs, and what is left stays in the
+// uio buffer
+static void test_input() {
+    feed link(8);
+    link.wire = "12 apples -345 rest";
+    {
+        uio::std_streambuf sb(link);
+        std::istream in(&sb);
+        int a = 0;
+        int b = 0;
+        std::string w;
+        in >> a >> w >> b;
+        assert(in && a == 12 && w == "apples" && b == -345);
+    }
+    char rest[8];
+    size_t n = link.ibuf().sgetn(rest, sizeof(rest));
+    assert(std::string(rest, n) == " r"); // the rest of the second sync
+    link.sync();
+    assert(link.ibuf().sgetn(rest, sizeof(rest)) == 3);
+
+    feed empty(8);
+    uio::std_streambuf sb(empty);
+    std::istream in(&sb);
+    int c;
+    assert(!(in >> c) && in.eof());
+}
+
+// both directions of an iostream, mixed with direct uio calls
+static void test_iostream() {
+    loopback link(64, 16);
+    uio::std_streambuf sb(link);
+    std::iostream io(&sb);
+    io << "hello " << 1 << ' ';
+    io.flush();
+    link.write("world", 5);
+    link.flush();
+    link.sync();
+    std::string w;
+    int i = 0;
+    io >> w >> i;
+    assert(w == "hello" && i == 1);
+    io >> w;
+    assert(w == "world");
+}
+
+int main() {
+    test_output();
+    test_output_overflow();
+    test_input();
+    test_iostream();
+    return 0;
+}
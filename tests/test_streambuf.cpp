@@ -0,0 +1,95 @@
+/*
+ * Tests for uio::streambuf.
+ *
+ * Build and run from the repository root:
+ *     c++ -I. tests/test_streambuf.cpp -o test_streambuf && ./test_streambuf
+ */
+#include <assert.h>
+#include <string.h>
+#include "uio.hpp"
+
+// compact after a dump empties the buffer instead of keeping read-out bytes
+static void test_compact_after_dump() {
+    char mem[16];
+    uio::streambuf sb;
+    sb.setbuf(mem, sizeof(mem));
+    assert(sb.sputn("hello", 5) == 5);
+    assert(memcmp(sb.dump(), "hello", sb.size()) == 0);
+    assert(sb.compact() == 5);
+    assert(sb.in_avail() == 0);
+    assert(sb.sputn("world", 5) == 5);
+    assert(sb.in_avail() == 5);
+    assert(memcmp(sb.gptr(), "world", 5) == 0);
+}
+
+// compact keeps the bytes that have yet to be read-out
+static void test_compact_partial() {
+    char mem[16];
+    char out[4];
+    uio::streambuf sb;
+    sb.setbuf(mem, sizeof(mem));
+    assert(sb.sputn("abcdef", 6) == 6);
+    assert(sb.sgetn(out, 4) == 4);
+    assert(sb.compact() == 4);
+    assert(sb.in_avail() == 2);
+    assert(memcmp(sb.gptr(), "ef", 2) == 0);
+    assert(sb.epptr() - sb.pptr() == 14);
+}
+
+// bytes written in place after everything was read-out survive compact
+static void test_compact_after_pbump() {
+    char mem[16];
+    char out[4];
+    uio::streambuf sb;
+    sb.setbuf(mem, sizeof(mem));
+    assert(sb.sputn("abcd", 4) == 4);
+    char* p = sb.pptr(); // e.g. a DMA transfer starts here
+    assert(sb.sgetn(out, 4) == 4);
+    memcpy(p, "efg", 3);
+    sb.pbump(3);
+    sb.compact();
+    assert(sb.in_avail() == 3);
+    assert(memcmp(sb.gptr(), "efg", 3) == 0);
+}
+
+// sputn<N> and sgetn<N> do what sputn and sgetn do, at every fill level
+template <size_t N>
+static void test_fixed_length() {
+    char fixed_mem[16];
+    char runtime_mem[16];
+    char data[N];
+    uio::streambuf fixed;
+    uio::streambuf runtime;
+    fixed.setbuf(fixed_mem, sizeof(fixed_mem));
+    runtime.setbuf(runtime_mem, sizeof(runtime_mem));
+    unsigned state = 1;
+    for (int i = 0; i < 1000; ++i) {
+        state = state * 1103515245 + 12345;
+        if (state >> 16 & 1) {
+            for (size_t j = 0; j < N; ++j) {
+                data[j] = (char) (i + j);
+            }
+            assert(fixed.sputn<N>(data) == runtime.sputn(data, N));
+        } else {
+            char a[N];
+            char b[N];
+            size_t n = fixed.sgetn<N>(a);
+            assert(n == runtime.sgetn(b, N));
+            assert(memcmp(a, b, n) == 0);
+        }
+        assert(fixed.in_avail() == runtime.in_avail());
+        assert(fixed.pptr() - fixed_mem == runtime.pptr() - runtime_mem);
+        assert(memcmp(fixed.gptr(), runtime.gptr(), fixed.in_avail()) == 0);
+    }
+}
+
+int main() {
+    test_compact_after_dump();
+    test_compact_partial();
+    test_compact_after_pbump();
+    test_fixed_length<1>();
+    test_fixed_length<4>();
+    test_fixed_length<7>();
+    test_fixed_length<16>();
+    return 0;
+}
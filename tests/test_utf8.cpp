@@ -0,0 +1,115 @@
+/*
+ * Tests for uio::utf8_istream and uio::utf16_istream.
+ *
+ * Build and run from the repository root (add -mssse3 to also check the
+ * vector validator against the scalar one):
+ *     c++ -I. tests/test_utf8.cpp -o test_utf8 && ./test_utf8
+ */
+#include <assert.h>
+#include <string.h>
+#include <string>
+#include "uio_utf8.hpp"
+#include "links.hpp"
+
+static void receive(uio::istream& in, std::string* got) {
+    in.sync();
+    uio::streambuf& sb = in.ibuf();
+    got->append(sb.gptr(), sb.in_avail());
+    sb.gbump(sb.in_avail());
+}
+
+// code points that cross the end of the link's input buffer are completed
+static void test_code_points_cross_buffer_end() {
+    const char* text = "a\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80"; // 10 bytes
+    feed link(8);
+    char buf[64];
+    uio::utf8_istream in(link);
+    in.setbuf(buf, sizeof(buf));
+    std::string sent;
+    for (int i = 0; i < 20; ++i) {
+        sent += text;
+    }
+    link.wire = sent;
+    std::string got;
+    for (int i = 0; i < 100 && got.size() < sent.size(); ++i) {
+        receive(in, &got);
+    }
+    assert(got == sent);
+    assert(!in._ierror._flags.corrupt);
+}
+
+// invalid bytes are replaced with U+FFFD, one per byte
+static void test_invalid_bytes_replaced() {
+    feed link(64);
+    char buf[64];
+    uio::utf8_istream in(link);
+    in.setbuf(buf, sizeof(buf));
+    link.wire = "a\xFF" "b\xC0\x80" "c\xED\xA0\x80";
+    std::string got;
+    receive(in, &got);
+    const char* r = "\xEF\xBF\xBD";
+    assert(got == std::string("a") + r + "b" + r + r + "c" + r + r + r);
+    assert(in._ierror._flags.corrupt);
+}
+
+// code points above U+FFFF become surrogate pairs
+static void test_utf16_surrogates() {
+    feed link(64);
+    char buf[64];
+    uio::utf16_istream le(link);
+    le.setbuf(buf, sizeof(buf));
+    link.wire = "A\xC3\xA9\xF0\x9F\x98\x80";
+    std::string got;
+    receive(le, &got);
+    assert(got == std::string("A\0\xE9\0\x3D\xD8\x00\xDE", 8));
+
+    uio::utf16_istream be(link, true);
+    be.setbuf(buf, sizeof(buf));
+    link.wire = "0123456789abcdefA\xF0\x9F\x98\x80";
+    got.clear();
+    receive(be, &got);
+    assert(got.size() == 38);
+    assert(got.compare(0, 4, std::string("\0" "0\0" "1", 4)) == 0);
+    assert(got.compare(32, 6, std::string("\0A\xD8\x3D\xDE\x00", 6)) == 0);
+}
+
+#if defined(__SSSE3__)
+static unsigned lcg(unsigned* state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 16;
+}
+
+// the vector validator agrees with the scalar one, tails included
+static void test_vector_matches_scalar() {
+    static const char* pieces[] = {
+        "a", "0123456789abcdef", "\xC3\xA9", "\xE2\x82\xAC",
+        "\xF0\x9F\x98\x80", "\xED\x9F\xBF", "\xF4\x8F\xBF\xBF"
+    };
+    unsigned state = 1;
+    for (int round = 0; round < 20000; ++round) {
+        std::string s;
+        size_t want = lcg(&state) % 80;
+        while (s.size() < want) {
+            s += pieces[lcg(&state) % 7];
+        }
+        if (lcg(&state) % 2 && !s.empty()) {
+            // corrupt, cut off or overlong, somewhere in the string
+            s[lcg(&state) % s.size()] = (char) lcg(&state);
+        }
+        bool truncated;
+        bool scalar = uio::utf8_check(s.data(), s.size(), &truncated)
+            == s.size() && !truncated;
+        assert(uio::utf8_validate(s.data(), s.size()) == scalar);
+    }
+}
+#endif
+
+int main() {
+    test_code_points_cross_buffer_end();
+    test_invalid_bytes_replaced();
+    test_utf16_surrogates();
+#if defined(__SSSE3__)
+    test_vector_matches_scalar();
+#endif
+    return 0;
+}
@@ -0,0 +1,121 @@
+/*
+ * Tests for the integer codec in uio_varint.hpp.
+ *
+ * Build and run from the repository root (add -mssse3 to test the vector
+ * decoder):
+ *     c++ -I. tests/test_varint.cpp -o test_varint && ./test_varint
+ */
+#include <assert.h>
+#include <string.h>
+#include <string>
+#include "uio_varint.hpp"
+#include "links.hpp"
+
+// varints round-trip, and one longer than 5 bytes is skipped as corrupt
+static void test_varint() {
+    loopback link(64);
+    const uint32_t values[] = { 0, 1, 127, 128, 16383, 16384, 0xFFFFFFFF };
+    for (size_t i = 0; i < 7; ++i) {
+        uio::write_varint(link, values[i]);
+    }
+    link.write("\x80\x80\x80\x80\x80\x80\x01", 7);
+    uio::write_varint(link, 300);
+    link.flush();
+    link.sync();
+
+    uint32_t v;
+    for (size_t i = 0; i < 7; ++i) {
+        assert(uio::read_varint(link, &v) && v == values[i]);
+    }
+    assert(!link._ierror._flags.corrupt);
+    assert(uio::read_varint(link, &v) == 7);
+    assert(link._ierror._flags.corrupt);
+    assert(uio::read_varint(link, &v) == 2 && v == 300);
+    assert(!uio::read_varint(link, &v));
+}
+
+static unsigned lcg(unsigned* state) {
+    *state = *state * 1103515245 + 12345;
+    return *state >> 16;
+}
+
+// records of every length up to a few groups, with deltas of every size,
+// round-trip, including records that end at the end of the input
+static void test_ints_round_trip() {
+    unsigned state = 1;
+    for (int round = 0; round < 200; ++round) {
+        loopback link(4096);
+        int32_t sent[8][40];
+        size_t lens[8];
+        for (size_t r = 0; r < 8; ++r) {
+            lens[r] = lcg(&state) % 40;
+            uint32_t x = lcg(&state) << 16 | lcg(&state);
+            for (size_t i = 0; i < lens[r]; ++i) {
+                int shift = lcg(&state) % 32;
+                x += (lcg(&state) << 16 | lcg(&state)) >> shift;
+                sent[r][i] = (int32_t) (lcg(&state) % 2 ? x : 0u - x);
+            }
+            uio::write_ints(link, sent[r], lens[r]);
+        }
+        assert(!link._oerror._flags.overflow);
+        link.flush();
+        link.sync();
+
+        for (size_t r = 0; r < 8; ++r) {
+            int32_t got[40];
+            size_t n;
+            assert(uio::read_ints(link, got, 40, &n) && n == lens[r]);
+            assert(memcmp(got, sent[r], n * sizeof(int32_t)) == 0);
+        }
+        assert(!link.ibuf().in_avail());
+    }
+}
+
+// a record is only consumed once all of it is in the input buffer, and an
+// empty record is told apart from an incomplete one
+static void test_ints_incomplete() {
+    loopback link(64);
+    const int32_t v[] = { 5, -70000, 3, 1 << 30, 0 };
+    uio::write_ints(link, v, 0);
+    uio::write_ints(link, v, 5);
+    link.flush();
+    std::string wire = link.wire;
+    link.wire.clear();
+
+    int32_t got[5];
+    size_t n = 99;
+    assert(!uio::read_ints(link, got, 5, &n) && n == 99);
+    link.wire = wire.substr(0, 1);
+    link.sync();
+    assert(uio::read_ints(link, got, 5, &n) && n == 0);
+    for (size_t i = 1; i < wire.size(); ++i) {
+        assert(!uio::read_ints(link, got, 5, &n));
+        link.wire = wire.substr(i, 1);
+        link.sync();
+    }
+    assert(uio::read_ints(link, got, 5, &n) && n == 5);
+    assert(memcmp(got, v, sizeof(v)) == 0);
+}
+
+// a record longer than the caller's array is discarded
+static void test_ints_overflow() {
+    loopback link(64);
+    const int32_t v[] = { 1, 2, 3, 4, 5, 6 };
+    uio::write_ints(link, v, 6);
+    uio::write_ints(link, v, 2);
+    link.flush();
+    link.sync();
+    int32_t got[4];
+    size_t n;
+    assert(uio::read_ints(link, got, 4, &n) && n == 0);
+    assert(link._ierror._flags.overflow);
+    assert(uio::read_ints(link, got, 4, &n) && n == 2 && got[1] == 2);
+}
+
+int main() {
+    test_varint();
+    test_ints_round_trip();
+    test_ints_incomplete();
+    test_ints_overflow();
+    return 0;
+}
@@ -44,6 +44,38 @@
  *
  */
 #include <cstring>
+#include <cstdarg>
+#include <cstdio>
+
+/// \cond DO_NOT_DOCUMENT
+#if __cplusplus >= 201103L
+#define UIO_CONSTEXPR constexpr
+#else
+#define UIO_CONSTEXPR
+#endif
+
+#if defined(va_copy)
+#define UIO_VA_COPY(d, s) va_copy(d, s)
+#elif defined(__va_copy)
+#define UIO_VA_COPY(d, s) __va_copy(d, s)
+#else
+#define UIO_VA_COPY(d, s) ((d) = (s))
+#endif
+
+#if defined(__GNUC__)
+#define UIO_PRINTF_FORMAT(f, a) __attribute__((format(printf, f, a)))
+#else
+#define UIO_PRINTF_FORMAT(f, a)
+#endif
+/// \endcond
+
+#ifndef UIO_PRINTF_CHUNK
+/**
+ * @brief Size of the stack buffer that streams which do not store their
+ * output in \c _obuf format into (see \ref uio::ostream::vprintf_write).
+ */
+#define UIO_PRINTF_CHUNK 128
+#endif
 
 namespace uio {
 
@@ -63,11 +95,25 @@ namespace uio {
     class streamerr {
     public:
 
-        struct {
+        /**
+         * @brief The bitmap of error flags.
+         */
+        struct flags {
             unsigned char 
             uninitialized: 1,   ///< Stream has not been properly initialized.
             overflow: 1,        ///< A buffer has overflowed.
-            reserved: 4;        ///< Application-layer error codes.
+            reserved: 4,        ///< Application-layer error codes.
+            corrupt: 1,         ///< Input failed an integrity check.
+            spare: 1;           ///< Unused (always clear).
+
+            /**
+             * @brief Constructor.
+             * 
+             * @param[in] u Initial value of \ref uninitialized.
+             */
+            UIO_CONSTEXPR flags(bool u = false)
+                : uninitialized(u), overflow(0), reserved(0), corrupt(0),
+                spare(0) {}
         } _flags; ///< The bitmap of error flags.
 
         /**
@@ -87,15 +133,23 @@ namespace uio {
          * @brief Clear all error flags.
          */
         inline void clear() {
-            memset(&_flags, 0, sizeof(_flags));
+            _flags = flags();
         }
 
         /**
          * @brief Default constructor.
+         * 
+         * @note This constructor is \c constexpr (C++11 and later), so 
+         * streams with static storage duration are constant-initialized.
          */
-        streamerr() {
-            memset(&_flags, 0, sizeof(_flags));
-        }
+        UIO_CONSTEXPR streamerr() : _flags() {}
+
+        /**
+         * @brief Construct with only \ref flags::uninitialized set to 
+         * \a uninitialized.
+         */
+        explicit UIO_CONSTEXPR streamerr(bool uninitialized) 
+            : _flags(uninitialized) {}
         
         /**
          * @brief Bitwise \ref _flags \c OR \c assignment \c operator.
@@ -128,15 +182,15 @@ namespace uio {
     public:
         /**
          * @brief Default constructor.
+         * 
+         * @note This constructor is \c constexpr (C++11 and later), so
+         * streams with static storage duration are constant-initialized 
+         * (e.g. they can be declared \c constinit) and need no code to run
+         * at startup.
          */
-        streambuf()  {
-            _capacity = 0;
-            _getpos = 0;
-            _putpos = 0;
-            _dump = false;
-            _buf = NULL;
-            _error._flags.uninitialized = true;
-        }
+        UIO_CONSTEXPR streambuf() 
+            : _capacity(0), _getpos(0), _putpos(0), _dump(false), _buf(NULL),
+            _error(true) {}
 
         /**
          * @brief Get the number of bytes available to be read-out.
@@ -187,6 +241,30 @@ namespace uio {
             return n;
         }
 
+        /**
+         * @brief Copies \a N bytes into \a s from the buffer.
+         * 
+         * This is \ref sgetn for a length that is known at compile time 
+         * (e.g. a fixed-size header). When \a N bytes are available, it 
+         * needs one check and a fixed-size copy that the compiler can 
+         * inline. Otherwise it behaves like \ref sgetn.
+         * 
+         * @tparam N Number of bytes to copy.
+         * @param[out] s Address to begin copying to.
+         * 
+         * @returns The number of bytes copied to \a s.
+         */
+        template<size_t N>
+        size_t sgetn(char* s) {
+            if (_putpos - _getpos < N) {
+                return sgetn(s, N);
+            }
+            memcpy(s, _buf + _getpos, N);
+            _getpos += N;
+            _dump = (_getpos == _putpos);
+            return N;
+        }
+
         /**
          * @brief Append \a c to the buffer.
          * 
@@ -235,6 +313,36 @@ namespace uio {
             return n;
         }
 
+        /**
+         * @brief Copy \a N bytes from \a s to the back of the buffer.
+         * 
+         * This is \ref sputn for a length that is known at compile time 
+         * (e.g. a fixed-size header). When there is room for \a N bytes, it
+         * needs one check and a fixed-size copy that the compiler can 
+         * inline. Otherwise it behaves like \ref sputn.
+         * 
+         * @tparam N Number of bytes to copy.
+         * @param[in] s Address to begin copying from.
+         * 
+         * @returns The number of bytes copied, beginning at \a s.
+         */
+        template<size_t N>
+        size_t sputn(const char* s) {
+            // check for dump
+            if (_dump) {
+                _putpos = 0;
+                _getpos= 0;
+                _dump = false;
+            }
+
+            if (_capacity - _putpos < N) {
+                return sputn(s, N);
+            }
+            memcpy(_buf + _putpos, s, N);
+            _putpos += N;
+            return N;
+        }
+
         /**
          * @brief Clear all buffer data and error flags.
          * 
@@ -304,6 +412,127 @@ namespace uio {
             return _putpos;
         }
 
+        /**
+         * @brief Get the size of the buffer's memory.
+         * 
+         * @returns The \a capacity given to \ref setbuf.
+         */
+        inline size_t capacity() const {
+            return _capacity;
+        }
+
+        /**
+         * @brief Get the address of the next byte to be read-out.
+         * 
+         * The bytes in [\ref gptr, \ref egptr) are the \ref in_avail bytes
+         * that have yet to be read-out. Adapters can use this to parse 
+         * buffered data in place, followed by \ref gbump to consume it.
+         * 
+         * @returns Address of the next byte to be read-out.
+         */
+        inline char* gptr() {
+            return _buf + _getpos;
+        }
+
+        /**
+         * @brief Get the address one past the last byte that can be read-out.
+         * 
+         * @see gptr
+         * 
+         * @returns Address one past the last byte in the buffer.
+         */
+        inline char* egptr() {
+            return _buf + _putpos;
+        }
+
+        /**
+         * @brief Consume \a n bytes that were read-out in place.
+         * 
+         * @attention \a n must not be greater than \ref in_avail.
+         * 
+         * @param[in] n Number of bytes to consume.
+         */
+        inline void gbump(size_t n) {
+            _getpos += n;
+            _dump = (_getpos == _putpos);
+        }
+
+        /**
+         * @brief Get the address that the next byte will be put to.
+         * 
+         * The bytes in [\ref pptr, \ref epptr) are free. Adapters can write
+         * to them directly, followed by \ref pbump to append them to the 
+         * buffer.
+         * 
+         * @returns Address that the next byte will be put to.
+         */
+        char* pptr() {
+            // check for dump
+            if (_dump) {
+                _putpos = 0;
+                _getpos= 0;
+                _dump = false;
+            }
+            return _buf + _putpos;
+        }
+
+        /**
+         * @brief Get the address one past the last byte of the buffer.
+         * 
+         * @see pptr
+         * 
+         * @returns Address one past the end of the buffer's memory.
+         */
+        inline char* epptr() {
+            return _buf + _capacity;
+        }
+
+        /**
+         * @brief Append \a n bytes that were written in place.
+         * 
+         * @attention \ref pptr must be called before writing to the buffer,
+         * and \a n must not be greater than \ref epptr minus \ref pptr.
+         * 
+         * @note Bytes appended after everything was read-out (e.g. by a
+         * transfer that was started before) are unread, so the buffer is no
+         * longer dumped.
+         * 
+         * @param[in] n Number of bytes to append.
+         */
+        inline void pbump(size_t n) {
+            if (n && _getpos == _putpos) {
+                _dump = false;
+            }
+            _putpos += n;
+        }
+
+        /**
+         * @brief Move the bytes that have yet to be read-out to the front of
+         * the buffer.
+         * 
+         * This makes room for more bytes to be put when a partially read-out
+         * record is left at the back of the buffer. After a \ref dump, every
+         * byte has been read-out, so the buffer is emptied instead.
+         * 
+         * @returns The number of bytes that were freed.
+         */
+        size_t compact() {
+            if (_dump) {
+                size_t n = _putpos;
+                _putpos = 0;
+                _getpos = 0;
+                _dump = false;
+                return n;
+            }
+            size_t n = _getpos;
+            if (n) {
+                memmove(_buf, _buf + _getpos, _putpos - _getpos);
+                _putpos -= _getpos;
+                _getpos = 0;
+            }
+            return n;
+        }
+
     private:
         size_t _capacity;
         size_t _getpos;
@@ -400,6 +629,18 @@ namespace uio {
          * @returns \c *this
          */
         virtual istream& sync() = 0;
+
+        /**
+         * @brief Get the input data \ref streambuf.
+         * 
+         * This lets adapters (e.g. codecs and parsers) work on the buffered
+         * input data in place rather than copying it out with \ref get.
+         * 
+         * @returns \c _ibuf
+         */
+        inline streambuf& ibuf() {
+            return _ibuf;
+        }
     protected:
         streambuf _ibuf; ///< Input data \ref streambuf.
     public:
@@ -485,6 +726,68 @@ namespace uio {
             }
         }
 
+        /**
+         * @brief Write formatted output, like \c printf.
+         * 
+         * The output is formatted straight into the free region of the 
+         * output buffer. If it does not fit, the stream is flushed and it 
+         * is formatted again.
+         * 
+         * @note \c vsnprintf needs one byte for its null character, 
+         * which is \em not kept in the buffer.
+         * 
+         * @note \c _oerror._flags.overflow is set, and the output is 
+         * truncated, if there is not enough space in the output buffer 
+         * after a flush.
+         * 
+         * @param[in] format The format string.
+         * 
+         * @returns \c *this
+         */
+        ostream& printf(const char* format, ...) UIO_PRINTF_FORMAT(2, 3) {
+            va_list args;
+            va_start(args, format);
+            vprintf(format, args);
+            va_end(args);
+            return *this;
+        }
+
+        /**
+         * @brief Write formatted output, like \c vprintf.
+         * 
+         * @see printf
+         * 
+         * @param[in] format The format string.
+         * @param[in] args The arguments.
+         * 
+         * @returns \c *this
+         */
+        virtual ostream& vprintf(const char* format, va_list args) {
+            va_list again;
+            UIO_VA_COPY(again, args);
+            char* p = _obuf.pptr();
+            size_t room = _obuf.epptr() - p;
+            int n = vsnprintf(p, room, format, args);
+            if (n >= 0 && (size_t) n >= room) {
+                flush();
+                p = _obuf.pptr();
+                room = _obuf.epptr() - p;
+                n = vsnprintf(p, room, format, again);
+            }
+            va_end(again);
+            if (n < 0) {
+                return *this;
+            }
+
+            size_t len = min((size_t) n, room ? room - 1 : 0);
+            _obuf.pbump(len);
+            if (len != (size_t) n) {
+                _oerror._flags.overflow = true;
+                _oerror |= _obuf._error;
+            }
+            return *this;
+        }
+
         /**
          * @brief A pure virtual function to flush buffered data to output 
          * data stream. 
@@ -495,7 +798,49 @@ namespace uio {
          * @returns \c *this
          */
         virtual ostream& flush() = 0;
+
+        /**
+         * @brief Get the output data \ref streambuf.
+         * 
+         * This lets adapters (e.g. codecs and framers) write output data in
+         * place rather than staging it and copying it in with \ref write.
+         * 
+         * @returns \c _obuf
+         */
+        inline streambuf& obuf() {
+            return _obuf;
+        }
     protected:
+        /**
+         * @brief Write formatted output through \ref write.
+         * 
+         * This is \ref vprintf for streams that do not store their output
+         * in \c _obuf (e.g. they override \ref write). The output is 
+         * formatted into a \ref UIO_PRINTF_CHUNK byte buffer on the stack
+         * and then written.
+         * 
+         * @note \c _oerror._flags.overflow is set, and the output is 
+         * truncated, if it does not fit in the stack buffer.
+         * 
+         * @param[in] format The format string.
+         * @param[in] args The arguments.
+         * 
+         * @returns \c *this
+         */
+        ostream& vprintf_write(const char* format, va_list args) {
+            char chunk[UIO_PRINTF_CHUNK];
+            int n = vsnprintf(chunk, sizeof(chunk), format, args);
+            if (n < 0) {
+                return *this;
+            }
+            size_t len = min((size_t) n, sizeof(chunk) - 1);
+            write(chunk, len);
+            if (len != (size_t) n) {
+                _oerror._flags.overflow = true;
+            }
+            return *this;
+        }
+
         streambuf _obuf; ///< Output stream \ref streambuf.
     public:
         streamerr _oerror; ///< Output stream \ref streamerr.
@@ -0,0 +1,566 @@
+#ifndef UIO_ARQ_H
+#define UIO_ARQ_H
+/**
+ * @file
+ * @brief Selective-repeat ARQ (automatic repeat request) over a lossy link.
+ *
+ * \par
+ * A \ref uio::arq_iostream sends its output as numbered HDLC frames and
+ * keeps up to a window of them in flight. The receiver acknowledges them
+ * cumulatively and with a bitmap of the frames it holds beyond the first
+ * gap (a selective ACK), and puts frames that arrive out of order aside
+ * until the gap is filled. Only lost frames are resent: on a retransmit
+ * timer derived from the measured round-trip time, or as soon as three
+ * later frames have been acknowledged. On a link with a long round trip
+ * the window keeps it busy, so throughput approaches the link's capacity
+ * rather than one frame per round trip.
+ *
+ * \par
+ * Sent bytes stay in the stream's output buffer until they are
+ * acknowledged, and frames (including retransmissions) are stuffed straight
+ * from there into the link's output buffer, so nothing is copied to a
+ * retransmit queue.
+ *
+ * \par
+ * Each frame starts with a 10-byte header: its type (0 for data, 1 for an
+ * ACK), the sender's receive window (in frames), its sequence number, the
+ * sender's next expected sequence number (the cumulative ACK), and the
+ * selective ACK bitmap, whose bit \c i is set if sequence number
+ * \c ack+1+i has been received. Numbers are sent least significant byte
+ * first. ACKs ride on data frames when there are any.
+ *
+ * \par
+ * Time is supplied by the application, in ticks of any unit:
+ *
+ * \code
+ * for (;;) {
+ *     radio.poll(millis());
+ *     ...
+ * }
+ * \endcode
+ */
+#include <stdint.h>
+#include "uio.hpp"
+#include "uio_hdlc.hpp"
+
+#ifndef UIO_ARQ_WINDOW
+/**
+ * @brief Largest window of a \ref uio::arq_iostream, in frames (at most
+ * 32, the width of a selective ACK).
+ */
+#define UIO_ARQ_WINDOW 32
+#endif
+
+#if UIO_ARQ_WINDOW > 32
+#error "UIO_ARQ_WINDOW must not be greater than 32"
+#endif
+
+namespace uio {
+
+    /// \cond DO_NOT_DOCUMENT
+    enum {
+        ARQ_DATA = 0,
+        ARQ_ACK = 1,
+        ARQ_HEADER = 10,
+        ARQ_DUPTHRESH = 3,  // later frames acknowledged before a resend
+        ARQ_BACKOFF = 6     // most doublings of the retransmit timeout
+    };
+
+    inline void arq_put(char* p, uint32_t v, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            p[i] = (char) (v >> (8 * i));
+        }
+    }
+
+    inline uint32_t arq_get(const char* p, size_t n) {
+        uint32_t v = 0;
+        for (size_t i = 0; i < n; ++i) {
+            v |= (uint32_t) (unsigned char) p[i] << (8 * i);
+        }
+        return v;
+    }
+    /// \endcond
+
+    /**
+     * @brief An input and output data stream that delivers its data reliably
+     * and in order over a link that drops and corrupts frames.
+     *
+     * Both ends of the link use an \c arq_iostream. \ref flush queues the
+     * buffered output for sending and \ref sync delivers received data to
+     * the input buffer, but frames are only resent, and the retransmit
+     * timers only run, when \ref poll is called, so it should be called
+     * regularly. Frames sent by \ref flush or \ref sync are timed from
+     * the next \ref poll, and only frames that are sent and acknowledged
+     * during \ref poll are used to measure the round trip.
+     *
+     * The output buffer holds both unsent and unacknowledged data, so for
+     * full throughput it should hold at least two windows of frames. The
+     * link's input buffer \em must hold a whole stuffed frame (at most
+     * <tt>2 * (10 + mss + fcs) + 2</tt> bytes). Both ends \em must use the
+     * same \c mss.
+     *
+     * @note This class is not thread-safe.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class arq_iostream : public iostream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to the link.
+         * @param[in] mss The largest payload of a frame.
+         * @param[in] rto The retransmit timeout, in ticks, until the round
+         * trip has been measured. It is also the least timeout (see
+         * \ref min_rto). Timeouts double while frames go unacknowledged,
+         * and (once the round trip has been measured) are reset when one is
+         * acknowledged.
+         * @param[in] fcs The frame check sequence.
+         */
+        arq_iostream(iostream& link, size_t mss, uint32_t rto,
+            hdlc_fcs fcs = HDLC_FCS32)
+            : _link(link), _framer(link, fcs), _deframer(link, fcs),
+            _mss(mss ? mss : 1) {
+            _window = UIO_ARQ_WINDOW;
+            _peer = 1;
+            _una = 0;
+            _nxt = 0;
+            _shead = 0;
+            _acked = 0;
+            _queued = 0;
+            _flushed = 0;
+            _rto = rto ? rto : 1;
+            _min_rto = _rto;
+            _backoff = 0;
+            _srtt = 0;
+            _rttvar = 0;
+            _timed = false;
+            _now = 0;
+            _polling = false;
+            _retransmits = 0;
+            _reorder = NULL;
+            _slots = 0;
+            _rwnd = 1;
+            _rnext = 0;
+            _rhead = 0;
+            _ack_due = false;
+            for (size_t i = 0; i < UIO_ARQ_WINDOW; ++i) {
+                _held[i] = false;
+                _len[i] = 0;
+            }
+        }
+
+        /**
+         * @brief Initialize the buffers.
+         *
+         * @param ibuf Memory allocation for the input buffer.
+         * @param icap Size of \a ibuf.
+         * @param obuf Memory allocation for the output buffer.
+         * @param ocap Size of \a obuf.
+         * @param reorder Memory allocation for frames that arrive out of
+         * order.
+         * @param rcap Size of \a reorder. The receive window is \a rcap / \c
+         * mss frames (from 1 to \ref UIO_ARQ_WINDOW). With no room for a
+         * frame, frames that arrive out of order are dropped.
+         *
+         * @returns \c this
+         */
+        arq_iostream* setbuf(char* ibuf, size_t icap, char* obuf,
+            size_t ocap, char* reorder, size_t rcap) {
+            _ibuf.setbuf(ibuf, icap);
+            _obuf.setbuf(obuf, ocap);
+            _reorder = reorder;
+            _slots = min((size_t) UIO_ARQ_WINDOW, reorder ? rcap / _mss : 0);
+            _rwnd = _slots ? _slots : 1;
+            return this;
+        }
+
+        /**
+         * @brief Set the send window.
+         *
+         * The window is also limited to the peer's receive window.
+         *
+         * @param[in] n The largest number of unacknowledged frames (from 1 to
+         * \ref UIO_ARQ_WINDOW).
+         *
+         * @returns \c this
+         */
+        arq_iostream* window(size_t n) {
+            _window = n < 1 ? 1 : min(n, (size_t) UIO_ARQ_WINDOW);
+            return this;
+        }
+
+        /**
+         * @brief Set the least retransmit timeout.
+         *
+         * It keeps the timeout above the delays that the round trip
+         * measurements miss (e.g. the time between calls to \ref poll).
+         *
+         * @param[in] n The least timeout, in ticks.
+         *
+         * @returns \c this
+         */
+        arq_iostream* min_rto(uint32_t n) {
+            _min_rto = n ? n : 1;
+            return this;
+        }
+
+        /**
+         * @brief Queue the buffered output for sending, and send as much of
+         * it as the window allows.
+         *
+         * @returns \c *this
+         */
+        virtual ostream& flush() {
+            _flushed = _acked + _obuf.in_avail();
+            service();
+            return *this;
+        }
+
+        /**
+         * @brief Receive frames and deliver their data to the input buffer.
+         *
+         * @returns \c *this
+         */
+        virtual istream& sync() {
+            service();
+            return *this;
+        }
+
+        /**
+         * @brief Receive, resend and send whatever the link allows.
+         *
+         * @param[in] now The current time, in ticks.
+         */
+        void poll(uint32_t now) {
+            _now = now;
+            _polling = true;
+
+            // frames sent by flush or sync are timed from now
+            for (size_t i = 0; i < inflight(); ++i) {
+                segment& s = seg(i);
+                if (!s.stamped) {
+                    s.sent = now;
+                    s.stamped = true;
+                }
+            }
+            service();
+            _polling = false;
+        }
+
+        /**
+         * @brief Get the number of frames that have not been acknowledged.
+         *
+         * @returns The number of frames in flight.
+         */
+        inline size_t inflight() const {
+            return (uint16_t) (_nxt - _una);
+        }
+
+        /**
+         * @brief Get the current retransmit timeout.
+         *
+         * @returns The timeout, in ticks.
+         */
+        inline uint32_t rto() const {
+            return _rto << _backoff;
+        }
+
+        /**
+         * @brief Get the number of frames that have been resent.
+         *
+         * @returns The number of retransmissions.
+         */
+        inline uint32_t retransmits() const {
+            return _retransmits;
+        }
+
+    private:
+        struct segment {
+            size_t off;         // stream offset of the first byte
+            size_t len;
+            uint32_t sent;      // time of the last transmission
+            uint32_t tries;
+            bool stamped;       // sent is known
+            bool exact;         // sent during poll, so it can be timed
+            bool sacked;
+            bool fast;          // resent after later frames were acked
+            bool due;           // to be resent
+        };
+
+        void service() {
+            receive();
+            deliver();
+            expire();
+            transmit();
+            if (_ack_due) {
+                send_frame(ARQ_ACK, 0, NULL, 0);
+            }
+            if ((size_t) (_obuf.epptr() - _obuf.pptr()) < _mss) {
+                _obuf.compact();
+            }
+            if (_link.obuf().in_avail()) {
+                _link.flush();
+            }
+        }
+
+        inline segment& seg(size_t i) {
+            return _seg[(_shead + i) % UIO_ARQ_WINDOW];
+        }
+
+        // ---- receiver
+
+        void receive() {
+            const char* f;
+            size_t n;
+            while (_deframer.next(&f, &n)) {
+                if (n < ARQ_HEADER || n > ARQ_HEADER + _mss) {
+                    continue;
+                }
+                _peer = min((size_t) (unsigned char) f[1],
+                    (size_t) UIO_ARQ_WINDOW);
+                ack((uint16_t) arq_get(f + 4, 2), arq_get(f + 6, 4));
+                if (f[0] == ARQ_DATA) {
+                    accept((uint16_t) arq_get(f + 2, 2), f + ARQ_HEADER,
+                        n - ARQ_HEADER);
+                }
+            }
+        }
+
+        void accept(uint16_t seq, const char* s, size_t n) {
+            _ack_due = true;
+            size_t d = (uint16_t) (seq - _rnext);
+            if (d >= _rwnd) {
+                return; // a duplicate, or beyond the window
+            }
+            size_t i = (_rhead + d) % _rwnd;
+            if (_held[i]) {
+                return;
+            }
+            if (!d && put_in(s, n)) {
+                advance();
+                return;
+            }
+            if (!_slots) {
+                return; // resent once it times out
+            }
+            memcpy(_reorder + i * _mss, s, n);
+            _len[i] = n;
+            _held[i] = true;
+        }
+
+        // move held frames that are next in order to the input buffer
+        void deliver() {
+            while (_rwnd && _held[_rhead]
+                && put_in(_reorder + _rhead * _mss, _len[_rhead])) {
+                _held[_rhead] = false;
+                advance();
+            }
+        }
+
+        inline void advance() {
+            _rhead = (_rhead + 1) % _rwnd;
+            ++_rnext;
+        }
+
+        bool put_in(const char* s, size_t n) {
+            if ((size_t) (_ibuf.epptr() - _ibuf.pptr()) < n) {
+                _ibuf.compact();
+                if ((size_t) (_ibuf.epptr() - _ibuf.pptr()) < n) {
+                    return false;
+                }
+            }
+            memcpy(_ibuf.pptr(), s, n);
+            _ibuf.pbump(n);
+            return true;
+        }
+
+        // the cumulative ACK and selective ACK bitmap
+        uint16_t acknowledgement(uint32_t* sack) const {
+            size_t k = 0;
+            while (k < _rwnd && _held[(_rhead + k) % _rwnd]) {
+                ++k;
+            }
+            *sack = 0;
+            for (size_t j = k + 1; j < _rwnd; ++j) {
+                if (_held[(_rhead + j) % _rwnd]) {
+                    *sack |= (uint32_t) 1 << (j - k - 1);
+                }
+            }
+            return (uint16_t) (_rnext + k);
+        }
+
+        // ---- sender
+
+        void ack(uint16_t cum, uint32_t sack) {
+            size_t n = inflight();
+            size_t d = (uint16_t) (cum - _una);
+            if (d > n) {
+                return; // stale
+            }
+
+            // only frames sent once, and acknowledged for the first time,
+            // give a round-trip sample (Karn's rule), and only if both
+            // happen during poll, when the time is known
+            const segment* timed = NULL;
+            bool progress = d != 0;
+            for (; d; --d, --n) {
+                segment& s = seg(0);
+                if (!s.sacked && s.tries == 1 && s.exact) {
+                    timed = &s;
+                }
+                _obuf.gbump(s.len);
+                _acked += s.len;
+                _shead = (_shead + 1) % UIO_ARQ_WINDOW;
+                ++_una;
+            }
+            for (size_t i = 0; sack >> i && i + 1 < n; ++i) {
+                segment& s = seg(i + 1);
+                if ((sack >> i) & 1 && !s.sacked) {
+                    s.sacked = true;
+                    s.due = false;
+                    progress = true;
+                    if (s.tries == 1 && s.exact) {
+                        timed = &s;
+                    }
+                }
+            }
+            if (timed && _polling) {
+                sample(_now - timed->sent);
+            }
+            if (progress && _timed) {
+                _backoff = 0;
+            }
+
+            // resend a frame once enough later frames have arrived
+            size_t later = 0;
+            for (size_t i = n; i--; ) {
+                segment& s = seg(i);
+                if (s.sacked) {
+                    ++later;
+                } else if (later >= ARQ_DUPTHRESH && !s.fast) {
+                    s.fast = true;
+                    s.due = true;
+                }
+            }
+        }
+
+        // RFC 6298, with the mean scaled by 8 and the deviation by 4 (so
+        // _rttvar is K * RTTVAR), a clock granularity G of one tick, and
+        // the least timeout
+        void sample(uint32_t r) {
+            if (!_timed) {
+                _srtt = r << 3;
+                _rttvar = r << 1;
+                _timed = true;
+            } else {
+                int32_t err = (int32_t) r - (int32_t) (_srtt >> 3);
+                _srtt += err;
+                _rttvar += (err < 0 ? -err : err) - (int32_t) (_rttvar >> 2);
+            }
+            _rto = (_srtt >> 3) + (_rttvar ? _rttvar : 1);
+            if (_rto < _min_rto) {
+                _rto = _min_rto;
+            }
+        }
+
+        void expire() {
+            bool fired = false;
+            for (size_t i = 0; i < inflight(); ++i) {
+                segment& s = seg(i);
+                if (!s.sacked && !s.due && s.stamped
+                    && _now - s.sent >= rto()) {
+                    s.due = true;
+                    fired = true;
+                }
+            }
+            if (fired && _backoff < ARQ_BACKOFF) {
+                ++_backoff;
+            }
+        }
+
+        void transmit() {
+            for (size_t i = 0; i < inflight(); ++i) {
+                if (seg(i).due && !send_segment(i)) {
+                    return;
+                }
+            }
+            while (inflight() < min(_window, _peer) && _flushed != _queued) {
+                segment& s = seg(inflight());
+                s.off = _queued;
+                s.len = min(_mss, _flushed - _queued);
+                s.tries = 0;
+                s.sacked = false;
+                s.fast = false;
+                _queued += s.len;
+                ++_nxt;
+                if (!send_segment(inflight() - 1)) {
+                    return;
+                }
+            }
+        }
+
+        // a frame that the link stops taking is resent when it times out
+        bool send_segment(size_t i) {
+            segment& s = seg(i);
+            s.sent = _now;
+            s.stamped = _polling;
+            s.exact = _polling;
+            s.due = false;
+            if (s.tries++) {
+                ++_retransmits;
+            }
+            return send_frame(ARQ_DATA, (uint16_t) (_una + i),
+                _obuf.gptr() + (s.off - _acked), s.len);
+        }
+
+        bool send_frame(char type, uint16_t seq, const char* s, size_t n) {
+            char h[ARQ_HEADER];
+            uint32_t sack;
+            h[0] = type;
+            h[1] = (char) _rwnd;
+            arq_put(h + 2, seq, 2);
+            arq_put(h + 4, acknowledgement(&sack), 2);
+            arq_put(h + 6, sack, 4);
+            _ack_due = false;
+            return _framer.begin() && _framer.append(h, ARQ_HEADER)
+                && _framer.append(s, n) && _framer.end();
+        }
+
+        iostream& _link;
+        hdlc_framer _framer;
+        hdlc_deframer _deframer;
+        size_t _mss;
+        size_t _window;
+        size_t _peer;           // the peer's receive window
+
+        segment _seg[UIO_ARQ_WINDOW];
+        uint16_t _una;          // oldest unacknowledged sequence number
+        uint16_t _nxt;          // next new sequence number
+        size_t _shead;          // index of _una in _seg
+        size_t _acked;          // stream offsets of the output buffer's gptr,
+        size_t _queued;         // of the end of the last frame,
+        size_t _flushed;        // and of the end of the flushed data
+        uint32_t _rto;
+        uint32_t _min_rto;
+        unsigned _backoff;
+        uint32_t _srtt;
+        uint32_t _rttvar;
+        bool _timed;
+        uint32_t _now;
+        bool _polling;          // in poll, so _now is the current time
+        uint32_t _retransmits;
+
+        char* _reorder;
+        size_t _slots;          // frames that fit in the reorder buffer
+        size_t _rwnd;
+        uint16_t _rnext;        // next sequence number to deliver
+        size_t _rhead;          // index of _rnext in the reorder slots
+        bool _held[UIO_ARQ_WINDOW];
+        size_t _len[UIO_ARQ_WINDOW];
+        bool _ack_due;
+    };
+};
+
+#endif // UIO_ARQ_H
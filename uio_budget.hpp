@@ -0,0 +1,636 @@
+#ifndef UIO_BUDGET_H
+#define UIO_BUDGET_H
+/**
+ * @file
+ * @brief A shared memory budget for stream buffers.
+ *
+ * \par
+ * A \ref uio::budget hands out buffer memory from one arena, under a global
+ * cap, to \ref uio::budget_istream and \ref uio::budget_ostream streams.
+ * Each stream's buffer grows on demand between a per-stream minimum and
+ * maximum, and \ref uio::budget::reclaim shrinks the buffers of drained
+ * streams back to their minimum. A stream that can not grow applies
+ * backpressure (it flushes, or it leaves input data in the peripheral)
+ * rather than dropping data.
+ *
+ * \par
+ * Streams can also be attached lazily: they draw no memory until their
+ * first write or \c sync, and give all of it back once they have been
+ * drained for an idle period, so resident memory tracks the streams that
+ * are active rather than the streams that are open.
+ *
+ * \par
+ * \ref uio::budget::tune moves each stream between size classes according
+ * to its traffic, and \ref uio::budget_buffer::suggested reports the size
+ * it chose (e.g. to freeze it into a static configuration).
+ */
+#include <stdint.h>
+#include "uio.hpp"
+
+namespace uio {
+
+    class budget_buffer;
+
+    /**
+     * @brief An arena of buffer memory with a global cap.
+     *
+     * Memory is handed out in power-of-two multiples of the block size by a
+     * buddy allocator, so freed buffers coalesce and can be handed out
+     * again at a different size.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class budget {
+    public:
+        /**
+         * @brief Default constructor.
+         */
+        budget() {
+            _base = NULL;
+            _map = NULL;
+            _block = 0;
+            _nblocks = 0;
+            _cap = 0;
+            _in_use = 0;
+            _now = 0;
+            _streams = NULL;
+            for (size_t k = 0; k < ORDERS; ++k) {
+                _free[k] = NULL;
+            }
+        }
+
+        /**
+         * @brief Initialize the arena.
+         *
+         * A small part of \a arena is used to track its blocks. The cap is
+         * set to the whole arena.
+         *
+         * @param arena Memory to hand out.
+         * @param size Size of \a arena.
+         * @param block Smallest amount of memory handed out. Rounded up to
+         * a power of two of at least two pointers.
+         *
+         * @returns \c this
+         */
+        budget* setbuf(char* arena, size_t size, size_t block) {
+            for (size_t k = 0; k < ORDERS; ++k) {
+                _free[k] = NULL;
+            }
+            _block = 2 * sizeof(node);
+            while (_block < block) {
+                _block <<= 1;
+            }
+
+            // carve the block map off the front, then align the blocks
+            size_t align = sizeof(node);
+            _nblocks = size / (_block + 1);
+            _map = (unsigned char*) arena;
+            size_t skip = (align - ((size_t) (arena + _nblocks) % align)) % align;
+            while (_nblocks && _nblocks + skip + _nblocks * _block > size) {
+                --_nblocks;
+                skip = (align - ((size_t) (arena + _nblocks) % align)) % align;
+            }
+            _base = arena + _nblocks + skip;
+            memset(_map, 0, _nblocks);
+
+            // free the arena as the largest aligned blocks that fit
+            size_t off = 0;
+            while (off < _nblocks) {
+                size_t k = 0;
+                while (k + 1 < ORDERS && !(off & (((size_t) 1 << (k + 1)) - 1))
+                    && off + ((size_t) 1 << (k + 1)) <= _nblocks) {
+                    ++k;
+                }
+                push(off, k);
+                off += (size_t) 1 << k;
+            }
+            _cap = _nblocks * _block;
+            _in_use = 0;
+            return this;
+        }
+
+        /**
+         * @brief Set the global cap.
+         *
+         * Lowering the cap below \ref in_use does not take memory away;
+         * the streams shrink as they drain and are reclaimed.
+         *
+         * @param[in] cap Most memory that may be handed out at once.
+         */
+        inline void limit(size_t cap) {
+            _cap = cap;
+        }
+
+        /**
+         * @brief Get the global cap.
+         *
+         * @returns Most memory that may be handed out at once.
+         */
+        inline size_t cap() const {
+            return _cap;
+        }
+
+        /**
+         * @brief Get the amount of memory that has been handed out.
+         *
+         * @returns The total size of all buffers that are in use.
+         */
+        inline size_t in_use() const {
+            return _in_use;
+        }
+
+        /**
+         * @brief Get memory for a buffer of at least \a n bytes.
+         *
+         * @param[in] n The number of bytes needed.
+         * @param[out] got The number of bytes handed out (\a n rounded up
+         * to the next block size class).
+         *
+         * @returns The memory, or \c NULL if the cap would be exceeded or no
+         * large enough block is free.
+         */
+        char* acquire(size_t n, size_t* got) {
+            size_t k = order(n);
+            if (k >= ORDERS) {
+                return NULL;
+            }
+            size_t size = _block << k;
+            if (_in_use + size > _cap) {
+                return NULL;
+            }
+            size_t j = k;
+            while (j < ORDERS && !_free[j]) {
+                ++j;
+            }
+            if (j == ORDERS) {
+                return NULL;
+            }
+
+            // split the block down to the size class
+            size_t off = index(_free[j]);
+            pop(off, j);
+            while (j > k) {
+                --j;
+                push(off + ((size_t) 1 << j), j);
+            }
+            _in_use += size;
+            *got = size;
+            return _base + off * _block;
+        }
+
+        /**
+         * @brief Give back memory from \ref acquire.
+         *
+         * @param[in] p The memory.
+         * @param[in] n The number of bytes that were handed out.
+         */
+        void release(char* p, size_t n) {
+            size_t k = order(n);
+            size_t off = (p - _base) / _block;
+            _in_use -= _block << k;
+
+            // coalesce with free buddies
+            while (k + 1 < ORDERS) {
+                size_t buddy = off ^ ((size_t) 1 << k);
+                if (buddy + ((size_t) 1 << k) > _nblocks
+                    || _map[buddy] != k + 1) {
+                    break;
+                }
+                pop(buddy, k);
+                off = off < buddy ? off : buddy;
+                ++k;
+            }
+            push(off, k);
+        }
+
+        /**
+         * @brief Shrink the buffers of drained streams to their size class.
+         *
+         * A stream's size class is its minimum size, unless \ref tune has
+         * moved it.
+         *
+         * @returns The amount of memory that was given back.
+         */
+        size_t reclaim();
+
+        /**
+         * @brief Shrink the buffers of drained streams, and release the 
+         * buffers of idle streams.
+         *
+         * A stream is idle once it has been drained, and has not grown, for
+         * \a idle ticks. The buffers of idle streams that were attached 
+         * lazily are released entirely; other streams are shrunk to their
+         * size class.
+         *
+         * @param[in] now The current time, in ticks.
+         * @param[in] idle Length of the idle period, in ticks.
+         *
+         * @returns The amount of memory that was given back.
+         */
+        size_t reclaim(uint32_t now, uint32_t idle);
+
+        /**
+         * @brief Move each stream to a new size class.
+         *
+         * A stream whose buffer had to grow, or that applied backpressure,
+         * since the last call moves up a size class (at least to the 
+         * largest fill level it reached). A stream whose fill level stayed
+         * under a quarter of its size class moves down a size class. 
+         * Drained streams are kept at (and shrunk to) their size class
+         * rather than their minimum. This should be called periodically.
+         */
+        void tune();
+
+    private:
+        friend class budget_buffer;
+
+        static const size_t ORDERS = sizeof(size_t) * 8;
+
+        struct node {
+            node* prev;
+            node* next;
+        };
+
+        size_t order(size_t n) const {
+            size_t k = 0;
+            while (k < ORDERS && (_block << k) < n) {
+                ++k;
+            }
+            return k;
+        }
+
+        size_t index(node* b) const {
+            return ((char*) b - _base) / _block;
+        }
+
+        void push(size_t off, size_t k) {
+            node* b = (node*) (_base + off * _block);
+            b->prev = NULL;
+            b->next = _free[k];
+            if (b->next) {
+                b->next->prev = b;
+            }
+            _free[k] = b;
+            _map[off] = (unsigned char) (k + 1);
+        }
+
+        void pop(size_t off, size_t k) {
+            node* b = (node*) (_base + off * _block);
+            if (b->prev) {
+                b->prev->next = b->next;
+            } else {
+                _free[k] = b->next;
+            }
+            if (b->next) {
+                b->next->prev = b->prev;
+            }
+            _map[off] = 0;
+        }
+
+        char* _base;
+        unsigned char* _map;
+        size_t _block;
+        size_t _nblocks;
+        size_t _cap;
+        size_t _in_use;
+        uint32_t _now;
+        node* _free[ORDERS];
+        budget_buffer* _streams;
+    };
+
+    /**
+     * @brief A stream buffer whose memory is drawn from a \ref budget.
+     */
+    class budget_buffer {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] sb The stream buffer to manage.
+         */
+        explicit budget_buffer(streambuf& sb) : _sb(sb) {
+            _budget = NULL;
+            _min = 0;
+            _max = 0;
+            _target = 0;
+            _high = 0;
+            _grows = 0;
+            _pressure = 0;
+            _mem = NULL;
+            _size = 0;
+            _lazy = false;
+            _last = 0;
+            _next = NULL;
+        }
+
+        virtual ~budget_buffer() {
+            detach();
+        }
+
+        /**
+         * @brief Draw the buffer's memory from \a b.
+         *
+         * Unless \a lazy is set, the buffer is given \a min bytes straight
+         * away. A lazy buffer draws no memory until it first grows, and 
+         * gives all of it back when it is idle (see \ref budget::reclaim).
+         *
+         * @param[in] b The budget to draw from.
+         * @param[in] min Smallest size of the buffer (while it is active).
+         * @param[in] max Largest size of the buffer.
+         * @param[in] lazy Whether memory is drawn on first use.
+         *
+         * @returns \c true if the minimum could be drawn from \a b.
+         */
+        bool attach(budget* b, size_t min, size_t max, bool lazy = false) {
+            detach();
+            _budget = b;
+            _min = min;
+            _max = max < min ? min : max;
+            _target = min;
+            _high = 0;
+            _grows = 0;
+            _pressure = 0;
+            _lazy = lazy;
+            _last = b->_now;
+            _next = b->_streams;
+            b->_streams = this;
+            return lazy || !min || grow(min);
+        }
+
+        /**
+         * @brief Give the buffer's memory back and stop drawing from the
+         * budget.
+         */
+        void detach() {
+            if (!_budget) {
+                return;
+            }
+            budget_buffer** p = &_budget->_streams;
+            while (*p != this) {
+                p = &(*p)->_next;
+            }
+            *p = _next;
+            if (_size) {
+                _budget->release(_mem, _size);
+                _sb.setbuf(NULL, 0);
+            }
+            _budget = NULL;
+            _mem = NULL;
+            _size = 0;
+        }
+
+        /**
+         * @brief Make room for \a n more bytes in the buffer.
+         *
+         * The buffer is compacted and, if that is not enough, moved to a
+         * larger block from the budget (up to its maximum size).
+         *
+         * @param[in] n The number of bytes to make room for.
+         *
+         * @returns \c true if there is room for \a n more bytes.
+         */
+        bool grow(size_t n) {
+            // a dumped buffer only counts as empty once it is compacted
+            _sb.compact();
+            size_t used = _sb.in_avail();
+            _high = used + n > _high ? used + n : _high;
+            if (_sb.capacity() - used >= n) {
+                return true;
+            }
+            if (!_budget || _sb.capacity() >= _max) {
+                return false;
+            }
+
+            // a lazy buffer is given at least its size class on first use
+            size_t got;
+            size_t need = used + n < _max ? used + n : _max;
+            need = need < _target ? _target : need;
+            _last = _budget->_now;
+            _grows += (_size != 0);
+            char* p = _budget->acquire(need, &got);
+            if (!p) {
+                return false;
+            }
+            if (_size) {
+                memcpy(p, _sb.gptr(), used);
+                _budget->release(_mem, _size);
+            }
+            _mem = p;
+            _size = got;
+            _sb.setbuf(p, got < _max ? got : _max);
+            _sb.pbump(used);
+            return _sb.capacity() - used >= n;
+        }
+
+        /**
+         * @brief Shrink the buffer to \a floor bytes if it is drained.
+         *
+         * @param[in] floor The size to shrink to (0 releases the buffer).
+         *
+         * @returns The amount of memory that was given back.
+         */
+        size_t shrink(size_t floor) {
+            if (!_budget || unread() || _sb.capacity() <= floor) {
+                return 0;
+            }
+            size_t n = _size;
+            _budget->release(_mem, _size);
+            _mem = NULL;
+            _size = 0;
+            _sb.setbuf(NULL, 0);
+            if (floor) {
+                grow(floor);
+            }
+            return n - _size;
+        }
+
+        /**
+         * @brief Get the buffer size chosen by \ref budget::tune.
+         *
+         * @returns The stream's current size class.
+         */
+        inline size_t suggested() const {
+            return _target;
+        }
+
+    protected:
+        /**
+         * @brief Record that the stream applied backpressure because its
+         * buffer could not grow.
+         */
+        inline void pressure() {
+            ++_pressure;
+        }
+
+        streambuf& _sb; ///< The managed stream buffer.
+
+    private:
+        friend class budget;
+
+        // the bytes that have yet to be read-out (pptr settles a dump
+        // without moving any of them)
+        inline size_t unread() {
+            _sb.pptr();
+            return _sb.in_avail();
+        }
+
+        budget* _budget;
+        size_t _min;
+        size_t _max;
+        size_t _target;
+        size_t _high;
+        size_t _grows;
+        size_t _pressure;
+        char* _mem;
+        size_t _size;
+        bool _lazy;
+        uint32_t _last;
+        budget_buffer* _next;
+    };
+
+    /// \cond DO_NOT_DOCUMENT
+    inline size_t budget::reclaim() {
+        size_t n = 0;
+        for (budget_buffer* s = _streams; s; s = s->_next) {
+            n += s->shrink(s->_target);
+        }
+        return n;
+    }
+
+    inline size_t budget::reclaim(uint32_t now, uint32_t idle) {
+        size_t n = 0;
+        _now = now;
+        for (budget_buffer* s = _streams; s; s = s->_next) {
+            if (s->unread()) {
+                s->_last = now;
+            } else if (s->_lazy && now - s->_last >= idle) {
+                n += s->shrink(0);
+            } else {
+                n += s->shrink(s->_target);
+            }
+        }
+        return n;
+    }
+
+    inline void budget::tune() {
+        for (budget_buffer* s = _streams; s; s = s->_next) {
+            size_t target = s->_target ? s->_target : _block;
+            if (s->_grows || s->_pressure) {
+                target <<= 1;
+                while (target < s->_high) {
+                    target <<= 1;
+                }
+            } else if (s->_high <= target / 4) {
+                target >>= 1;
+            }
+            target = target < s->_min ? s->_min : target;
+            s->_target = target > s->_max ? s->_max : target;
+            s->_high = s->unread();
+            s->_grows = 0;
+            s->_pressure = 0;
+        }
+    }
+    /// \endcond
+
+    /**
+     * @brief An output stream whose buffer is drawn from a \ref budget.
+     *
+     * When the output buffer is full it grows; if it can not grow, the
+     * stream is flushed to make room.
+     *
+     * @attention \ref attach \em must be called before this class can
+     * be used.
+     */
+    class budget_ostream : public ostream, public budget_buffer {
+    public:
+        /**
+         * @brief Default constructor.
+         */
+        budget_ostream() : budget_buffer(_obuf) {}
+
+        virtual ostream& operator<<(const char* s) {
+            return write(s, strlen(s));
+        }
+
+        virtual ostream& put(char c) {
+            return write(&c, 1);
+        }
+
+        virtual ostream& vprintf(const char* format, va_list args) {
+            va_list again;
+            UIO_VA_COPY(again, args);
+            int n = vsnprintf(NULL, 0, format, args);
+            if (n >= 0) {
+                grow((size_t) n + 1); // and the null character
+            }
+            ostream::vprintf(format, again);
+            va_end(again);
+            return *this;
+        }
+
+        /**
+         * @brief Write \a n bytes from \a s to the output data stream.
+         *
+         * Whatever does not fit after growing the buffer is written in 
+         * pieces, flushing the stream after each one.
+         *
+         * @note \c _oerror._flags.overflow is only set if flushing does not
+         * make any room.
+         *
+         * @returns \c *this
+         */
+        virtual ostream& write(const char* s, size_t n) {
+            grow(n);
+            size_t m = _obuf.sputn(s, n);
+            while (m < n) {
+                pressure();
+                flush();
+                grow(n - m);
+                size_t k = _obuf.sputn(s + m, n - m);
+                if (!k) {
+                    _oerror._flags.overflow = true;
+                    _oerror |= _obuf._error;
+                    break;
+                }
+                m += k;
+            }
+            return *this;
+        }
+    };
+
+    /**
+     * @brief An input stream whose buffer is drawn from a \ref budget.
+     *
+     * Implementations of \ref sync should call \ref reserve_in before
+     * putting input data into \c _ibuf, and leave any data that does not
+     * fit in the peripheral.
+     *
+     * @attention \ref attach \em must be called before this class can
+     * be used.
+     */
+    class budget_istream : public istream, public budget_buffer {
+    public:
+        /**
+         * @brief Default constructor.
+         */
+        budget_istream() : budget_buffer(_ibuf) {}
+
+        /**
+         * @brief Make room for up to \a n more bytes of input data.
+         *
+         * @param[in] n The number of bytes to make room for.
+         *
+         * @returns The free space in the input buffer (which is less than
+         * \a n if the buffer could not grow).
+         */
+        size_t reserve_in(size_t n) {
+            if (!grow(n)) {
+                pressure();
+            }
+            return _ibuf.capacity() - _ibuf.size();
+        }
+    };
+};
+
+#endif // UIO_BUDGET_H
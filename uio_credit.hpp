@@ -0,0 +1,263 @@
+#ifndef UIO_CREDIT_H
+#define UIO_CREDIT_H
+/**
+ * @file
+ * @brief Credit-based flow control between two streams.
+ *
+ * \par
+ * Each end of a link uses a \ref uio::credit_iostream. The receiver grants
+ * the sender credits for the free space in its input buffer, and the
+ * sender only sends as many bytes as it holds credits for. Data that can
+ * not be sent yet stays in the sender's output buffer, so a fast sender is
+ * held back by a slow receiver (and, once its output buffer is full, by
+ * \c _oerror._flags.overflow on write) rather than overrunning the
+ * receiver's input buffer, and it sends at full speed whenever the
+ * receiver keeps up.
+ *
+ * \par
+ * The link carries records, each of a 6-byte header and up to 65535 bytes
+ * of data. The header holds the sender's grant (the total number of bytes
+ * it is willing to receive since the stream started) and the length of the
+ * data, least significant byte first. Grants ride on data records in the
+ * other direction when there are any; otherwise a record with no data is
+ * sent once at least half of the input buffer has been freed. Grants are
+ * totals rather than increments, so a repeated or late grant is harmless.
+ *
+ * \par
+ * The link \em must be reliable and in order (e.g. a socket, or an
+ * \ref uio::arq_iostream).
+ */
+#include <stdint.h>
+#include "uio.hpp"
+
+namespace uio {
+
+    /// \cond DO_NOT_DOCUMENT
+    enum {
+        CREDIT_HEADER = 6,
+        CREDIT_RECORD = 0xFFFF  // most data in a record
+    };
+
+    inline void credit_put(char* p, uint32_t v, size_t n) {
+        for (size_t i = 0; i < n; ++i) {
+            p[i] = (char) (v >> (8 * i));
+        }
+    }
+
+    inline uint32_t credit_get(const char* p, size_t n) {
+        uint32_t v = 0;
+        for (size_t i = 0; i < n; ++i) {
+            v |= (uint32_t) (unsigned char) p[i] << (8 * i);
+        }
+        return v;
+    }
+    /// \endcond
+
+    /**
+     * @brief An input and output data stream whose output is limited to the
+     * free space in its peer's input buffer.
+     *
+     * \ref flush sends as much of the buffered output as the peer has
+     * granted credits for, and the rest is sent by later calls to
+     * \ref flush or \ref sync as credits arrive. \ref sync receives data and
+     * credits, and grants credits for the input buffer's free space, so
+     * both ends should call it regularly (e.g. whenever they poll for
+     * input).
+     *
+     * Nothing is sent until the peer's first grant, which its first
+     * \ref sync sends.
+     *
+     * @note Data beyond the granted credits is dropped and sets
+     * \c _ierror._flags.overflow (only a misbehaving peer sends it).
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class credit_iostream : public iostream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to the link.
+         */
+        explicit credit_iostream(iostream& link) : _link(link) {
+            _sent = 0;
+            _limit = 0;
+            _flushed = 0;
+            _received = 0;
+            _granted = 0;
+            _left = 0;
+        }
+
+        /**
+         * @brief Initialize the buffers.
+         *
+         * @param ibuf Memory allocation for the input buffer.
+         * @param icap Size of \a ibuf (i.e. the most credits granted at
+         * once).
+         * @param obuf Memory allocation for the output buffer.
+         * @param ocap Size of \a obuf.
+         *
+         * @returns \c this
+         */
+        credit_iostream* setbuf(char* ibuf, size_t icap, char* obuf,
+            size_t ocap) {
+            _ibuf.setbuf(ibuf, icap);
+            _obuf.setbuf(obuf, ocap);
+            return this;
+        }
+
+        /**
+         * @brief Send as much of the buffered output as the credits allow.
+         *
+         * The rest is sent by later calls to \ref flush or \ref sync.
+         *
+         * @returns \c *this
+         */
+        virtual ostream& flush() {
+            _flushed = _obuf.in_avail();
+            send();
+            return *this;
+        }
+
+        /**
+         * @brief Receive data and credits, grant credits, and send flushed
+         * output that the new credits allow.
+         *
+         * @returns \c *this
+         */
+        virtual istream& sync() {
+            if (_ibuf._error._flags.uninitialized) {
+                return *this;
+            }
+            _ibuf.compact();
+            _link.ibuf().compact(); // make room after a partial header
+            _link.sync();
+            receive();
+            if (_flushed) {
+                send();
+            }
+            size_t half = _ibuf.capacity() / 2;
+            if (limit() - _granted >= (half ? half : 1) && grant()) {
+                _link.flush();
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Get the number of bytes that may be sent.
+         *
+         * @returns The credits held.
+         */
+        inline size_t credit() const {
+            return (size_t) (_limit - _sent);
+        }
+
+        /**
+         * @brief Get the number of flushed bytes that are waiting for
+         * credits.
+         *
+         * @returns The number of bytes.
+         */
+        inline size_t pending() const {
+            return _flushed;
+        }
+
+    private:
+        // the total number of bytes this end can receive
+        inline uint32_t limit() const {
+            return _received + (uint32_t) (_ibuf.capacity()
+                - _ibuf.in_avail());
+        }
+
+        // put a record header in the link's output buffer
+        bool header(size_t len) {
+            streambuf& sb = _link.obuf();
+            if ((size_t) (sb.epptr() - sb.pptr()) < CREDIT_HEADER + len) {
+                _link.flush();
+                if ((size_t) (sb.epptr() - sb.pptr()) < CREDIT_HEADER + len) {
+                    return false;
+                }
+            }
+            _granted = limit();
+            char* p = sb.pptr();
+            credit_put(p, _granted, 4);
+            credit_put(p + 4, (uint32_t) len, 2);
+            sb.pbump(CREDIT_HEADER);
+            return true;
+        }
+
+        inline bool grant() {
+            return header(0);
+        }
+
+        void send() {
+            bool sent = false;
+            while (_flushed && credit()) {
+                streambuf& sb = _link.obuf();
+                size_t room = sb.epptr() - sb.pptr();
+                if (room <= CREDIT_HEADER) {
+                    _link.flush();
+                    room = sb.epptr() - sb.pptr();
+                    if (room <= CREDIT_HEADER) {
+                        break;
+                    }
+                }
+                size_t n = min(min(_flushed, credit()),
+                    min(room - CREDIT_HEADER, (size_t) CREDIT_RECORD));
+                header(n);
+                memcpy(sb.pptr(), _obuf.gptr(), n);
+                sb.pbump(n);
+                _obuf.gbump(n);
+                _flushed -= n;
+                _sent += (uint32_t) n;
+                sent = true;
+            }
+            if (sent) {
+                _obuf.compact();
+                _link.flush();
+            }
+        }
+
+        void receive() {
+            streambuf& sb = _link.ibuf();
+            for (;;) {
+                if (!_left) {
+                    if (sb.in_avail() < CREDIT_HEADER) {
+                        return;
+                    }
+                    uint32_t limit = credit_get(sb.gptr(), 4);
+                    if ((int32_t) (limit - _limit) > 0) {
+                        _limit = limit;
+                    }
+                    _left = credit_get(sb.gptr() + 4, 2);
+                    sb.gbump(CREDIT_HEADER);
+                }
+
+                size_t n = min(_left, sb.in_avail());
+                if (!n) {
+                    return;
+                }
+                size_t k = min(n, (size_t) (_ibuf.epptr() - _ibuf.pptr()));
+                memcpy(_ibuf.pptr(), sb.gptr(), k);
+                _ibuf.pbump(k);
+                _received += (uint32_t) k;
+                if (k < n) {
+                    _ierror._flags.overflow = true;
+                }
+                sb.gbump(n);
+                _left -= n;
+            }
+        }
+
+        iostream& _link;
+        uint32_t _sent;     // total bytes sent
+        uint32_t _limit;    // the peer's grant
+        size_t _flushed;    // flushed bytes not sent yet
+        uint32_t _received; // total bytes received
+        uint32_t _granted;  // the last grant sent
+        size_t _left;       // data left in the record being received
+    };
+};
+
+#endif // UIO_CREDIT_H
@@ -0,0 +1,383 @@
+#ifndef UIO_CSV_H
+#define UIO_CSV_H
+/**
+ * @file
+ * @brief Streaming CSV (RFC 4180) reader and writer.
+ *
+ * \par
+ * A \ref uio::csv_reader returns the fields of an input stream one at a
+ * time, as views into the stream's input buffer. It classifies 64 bytes
+ * at a time into bitmasks of quotes and separators, and a prefix XOR of
+ * the quote mask tells which separators are inside quoted fields, so there
+ * is no per-byte state machine. Quoted fields are unescaped in place.
+ *
+ * \par
+ * A \ref uio::csv_writer writes fields straight into an output stream's
+ * buffer, and only quotes a field if it contains a delimiter, quote or line
+ * break.
+ */
+#include <stdint.h>
+#include "uio.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace uio {
+
+    /**
+     * @brief A field, in the input buffer.
+     *
+     * The field is not null-terminated.
+     */
+    struct csv_field {
+        const char* data;   ///< First character of the field.
+        size_t len;         ///< Number of characters in the field.
+        bool last;          ///< The field ends its record.
+    };
+
+    /// \cond DO_NOT_DOCUMENT
+    // bit i of each mask is set if s[i] is a quote, a delimiter or newline,
+    // or a carriage return (n <= 64)
+    inline void csv_classify(const char* s, size_t n, char delim,
+        uint64_t* quote, uint64_t* sep, uint64_t* cr) {
+#if defined(__SSE2__)
+        if (n == 64) {
+            uint64_t q = 0;
+            uint64_t d = 0;
+            uint64_t r = 0;
+            const __m128i vq = _mm_set1_epi8('"');
+            const __m128i vd = _mm_set1_epi8(delim);
+            const __m128i vn = _mm_set1_epi8('\n');
+            const __m128i vr = _mm_set1_epi8('\r');
+            for (size_t i = 0; i < 64; i += 16) {
+                __m128i v = _mm_loadu_si128((const __m128i*) (s + i));
+                q |= (uint64_t) (uint16_t) _mm_movemask_epi8(
+                    _mm_cmpeq_epi8(v, vq)) << i;
+                d |= (uint64_t) (uint16_t) _mm_movemask_epi8(_mm_or_si128(
+                    _mm_cmpeq_epi8(v, vd), _mm_cmpeq_epi8(v, vn))) << i;
+                r |= (uint64_t) (uint16_t) _mm_movemask_epi8(
+                    _mm_cmpeq_epi8(v, vr)) << i;
+            }
+            *quote = q;
+            *sep = d;
+            *cr = r;
+            return;
+        }
+#endif
+        uint64_t q = 0;
+        uint64_t d = 0;
+        uint64_t r = 0;
+        for (size_t i = 0; i < n; ++i) {
+            char c = s[i];
+            q |= (uint64_t) (c == '"') << i;
+            d |= (uint64_t) (c == delim || c == '\n') << i;
+            r |= (uint64_t) (c == '\r') << i;
+        }
+        *quote = q;
+        *sep = d;
+        *cr = r;
+    }
+
+    // bit i is the XOR of bits [0, i]
+    inline uint64_t csv_prefix_xor(uint64_t x) {
+        x ^= x << 1;
+        x ^= x << 2;
+        x ^= x << 4;
+        x ^= x << 8;
+        x ^= x << 16;
+        x ^= x << 32;
+        return x;
+    }
+
+    inline unsigned csv_ctz(uint64_t x) {
+#if defined(__GNUC__)
+        return (unsigned) __builtin_ctzll(x);
+#else
+        unsigned n = 0;
+        for (; !(x & 1); x >>= 1) {
+            ++n;
+        }
+        return n;
+#endif
+    }
+    /// \endcond
+
+    /**
+     * @brief A reader of the fields in an input stream.
+     *
+     * Fields are returned in place in the stream's input buffer, so the
+     * longest field must fit in that buffer; a longer field is returned in
+     * pieces (not unescaped) and sets the stream's
+     * \c _ierror._flags.overflow.
+     */
+    class csv_reader {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to read.
+         * @param[in] delim The field delimiter.
+         */
+        explicit csv_reader(istream& link, char delim = ',')
+            : _link(link), _delim(delim) {
+            _start = 0;
+            _len = 0;
+            _bits = 0;
+            _inside = false;
+            _consumed = 0;
+            _field = 0;
+        }
+
+        /**
+         * @brief Get the next field.
+         *
+         * The previous field is released first. The stream is synced (at
+         * most once) if the buffered input does not hold a complete field.
+         *
+         * @param[out] f The field. It stays valid until it is released.
+         * @param[in] end \c true if no more input will arrive, so that the
+         * rest of the buffered input is the last field.
+         *
+         * @returns \c true if a field was read.
+         */
+        bool next(csv_field* f, bool end = false) {
+            release();
+            for (bool synced = false; ; synced = true) {
+                if (scan(f)) {
+                    return true;
+                }
+                if (synced) {
+                    break;
+                }
+                _link.ibuf().compact(); // make room for the rest of the field
+                _link.sync();
+            }
+
+            streambuf& sb = _link.ibuf();
+            size_t n = sb.in_avail();
+            if (n && sb.pptr() == sb.epptr()) {
+                _link._ierror._flags.overflow = true;
+                f->data = sb.gptr();
+                f->len = n;
+                f->last = false;
+                _field = n;
+                return true;
+            }
+            if (n && end) {
+                f->last = true;
+                unquote(f, sb.gptr(), n);
+                _field = n;
+                _bits = 0;
+                _inside = false;
+                return true;
+            }
+            return false;
+        }
+
+        /**
+         * @brief Release the last field's space in the input buffer.
+         */
+        void release() {
+            if (_field) {
+                _link.ibuf().gbump(_field);
+                _consumed += _field;
+                _field = 0;
+            }
+        }
+
+    private:
+        bool scan(csv_field* f) {
+            streambuf& sb = _link.ibuf();
+            char* base = sb.gptr();
+            size_t n = sb.in_avail();
+            for (;;) {
+                if (_bits) {
+                    size_t p = _start + csv_ctz(_bits) - _consumed;
+                    _bits &= _bits - 1;
+                    f->last = (base[p] == '\n');
+                    unquote(f, base, p);
+                    _field = p + 1;
+                    return true;
+                }
+
+                // classify the next block
+                size_t pos = _start + _len - _consumed;
+                if (pos >= n) {
+                    return false;
+                }
+                size_t k = min((size_t) 64, n - pos);
+                uint64_t quote;
+                uint64_t sep;
+                uint64_t cr;
+                csv_classify(base + pos, k, _delim, &quote, &sep, &cr);
+                uint64_t inside = csv_prefix_xor(quote)
+                    ^ (_inside ? ~(uint64_t) 0 : 0);
+                _bits = sep & ~inside;
+                _inside = (inside >> (k - 1)) & 1;
+                _start += _len;
+                _len = k;
+            }
+        }
+
+        // view [s, s + n) without its line end and quotes
+        static void unquote(csv_field* f, char* s, size_t n) {
+            if (f->last && n && s[n - 1] == '\r') {
+                --n;
+            }
+            f->data = s;
+            f->len = n;
+            if (n < 2 || s[0] != '"' || s[n - 1] != '"') {
+                return;
+            }
+
+            // collapse "" to " in place
+            char* out = s + 1;
+            const char* in = s + 1;
+            const char* e = s + n - 1;
+            while (in < e) {
+                const char* q = (const char*) memchr(in, '"', e - in);
+                size_t k = (q ? q : e) - in;
+                memmove(out, in, k);
+                out += k;
+                in += k;
+                if (q) {
+                    *out++ = '"';
+                    in += (q + 1 < e && q[1] == '"') ? 2 : 1;
+                }
+            }
+            f->data = s + 1;
+            f->len = out - (s + 1);
+        }
+
+        istream& _link;
+        char _delim;
+        size_t _start;      // consumed-relative offset of the classified block
+        size_t _len;        // length of the classified block
+        uint64_t _bits;     // separators in the block not yet returned
+        bool _inside;       // quote state after the block
+        size_t _consumed;   // bytes released so far
+        size_t _field;      // length of the last field and its separator
+    };
+
+    /**
+     * @brief A writer of fields to an output stream.
+     *
+     * Fields are written straight into the stream's output buffer, which is
+     * flushed whenever it fills up.
+     *
+     * @note \c _oerror._flags.overflow of the stream is set if it stops
+     * taking bytes.
+     */
+    class csv_writer {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to write to.
+         * @param[in] delim The field delimiter.
+         */
+        explicit csv_writer(ostream& link, char delim = ',')
+            : _link(link), _delim(delim) {
+            _first = true;
+        }
+
+        /**
+         * @brief Write a field.
+         *
+         * The field is quoted only if it contains the delimiter, a quote
+         * or a line break.
+         *
+         * @param[in] s The field's first character.
+         * @param[in] n The length of the field.
+         *
+         * @returns \c *this
+         */
+        csv_writer& field(const char* s, size_t n) {
+            if (!_first) {
+                put_raw(&_delim, 1);
+            }
+            _first = false;
+
+            bool quote = false;
+            for (size_t i = 0; i < n && !quote; i += 64) {
+                uint64_t q;
+                uint64_t sep;
+                uint64_t cr;
+                csv_classify(s + i, min((size_t) 64, n - i), _delim, &q, &sep,
+                    &cr);
+                quote = (q | sep | cr) != 0;
+            }
+            if (!quote) {
+                put_raw(s, n);
+                return *this;
+            }
+
+            // double each quote by writing it twice
+            put_raw("\"", 1);
+            const char* e = s + n;
+            while (s < e) {
+                const char* q = (const char*) memchr(s, '"', e - s);
+                size_t k = (q ? q + 1 : e) - s;
+                put_raw(s, k);
+                s += k;
+                if (q) {
+                    put_raw("\"", 1);
+                }
+            }
+            put_raw("\"", 1);
+            return *this;
+        }
+
+        /**
+         * @brief Write a null-terminated field.
+         *
+         * @param[in] s The field.
+         *
+         * @returns \c *this
+         */
+        inline csv_writer& field(const char* s) {
+            return field(s, strlen(s));
+        }
+
+        /**
+         * @brief End the record (with CR LF).
+         *
+         * @returns \c *this
+         */
+        csv_writer& end_record() {
+            put_raw("\r\n", 2);
+            _first = true;
+            return *this;
+        }
+
+    private:
+        // copy to the link, flushing it when its buffer is full
+        void put_raw(const char* s, size_t n) {
+            streambuf& sb = _link.obuf();
+            while (n) {
+                char* p = sb.pptr();
+                if (p == sb.epptr()) {
+                    _link.flush();
+                    p = sb.pptr();
+                    if (p == sb.epptr()) {
+                        _link._oerror._flags.overflow = true;
+                        _link._oerror |= sb._error;
+                        return;
+                    }
+                }
+                size_t k = min((size_t) (sb.epptr() - p), n);
+                memcpy(p, s, k);
+                sb.pbump(k);
+                s += k;
+                n -= k;
+            }
+        }
+
+        ostream& _link;
+        char _delim;
+        bool _first;
+    };
+};
+
+#endif // UIO_CSV_H
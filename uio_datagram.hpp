@@ -0,0 +1,299 @@
+#ifndef UIO_DATAGRAM_H
+#define UIO_DATAGRAM_H
+/**
+ * @file
+ * @brief Streams that keep message boundaries.
+ *
+ * \par
+ * A \ref uio::datagram_iostream sends and receives whole messages over a
+ * transport that has its own boundaries (e.g. UDP, \c SOCK_SEQPACKET or
+ * CAN), so no framing has to be added to the bytes. Messages are written
+ * with the usual \c write and \c put calls and ended with
+ * \ref uio::datagram_iostream::commit, and \c flush sends each committed
+ * message as one datagram. Received datagrams are stored back to back in
+ * the input buffer, and their lengths are kept on the side (2 bytes per
+ * message), so \ref uio::datagram_iostream::get_message hands each one out
+ * in place.
+ */
+#include <stdint.h>
+#include "uio.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#endif
+
+#ifndef UIO_DATAGRAM_QUEUE
+/**
+ * @brief Most messages a \ref uio::datagram_iostream holds in each
+ * direction.
+ */
+#define UIO_DATAGRAM_QUEUE 32
+#endif
+
+namespace uio {
+
+    /**
+     * @brief An input and output data stream of messages.
+     *
+     * Derived classes implement \ref send_datagram and \ref recv_datagram
+     * for the transport.
+     *
+     * @attention Input \em must be read with \ref get_message only, since
+     * reading it as bytes (e.g. with \c get) loses the message boundaries.
+     * \ref setbuf \em must be called before this class can be used.
+     */
+    class datagram_iostream : public iostream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] mtu The largest datagram (at most 65535 bytes).
+         */
+        explicit datagram_iostream(size_t mtu) {
+            _mtu = min(mtu, (size_t) 0xFFFF);
+            _ihead = 0;
+            _icount = 0;
+            _held = 0;
+            _ohead = 0;
+            _ocount = 0;
+            _committed = 0;
+            _dropped = 0;
+        }
+
+        virtual ~datagram_iostream() {}
+
+        /**
+         * @brief Initialize the buffers.
+         *
+         * @param ibuf Memory allocation for the input buffer.
+         * @param icap Size of \a ibuf (at least the MTU).
+         * @param obuf Memory allocation for the output buffer.
+         * @param ocap Size of \a obuf.
+         *
+         * @returns \c this
+         */
+        datagram_iostream* setbuf(char* ibuf, size_t icap, char* obuf,
+            size_t ocap) {
+            _ibuf.setbuf(ibuf, icap);
+            _obuf.setbuf(obuf, ocap);
+            return this;
+        }
+
+        /**
+         * @brief End the message that has been written since the last one.
+         *
+         * The stream is flushed first if it already holds
+         * \ref UIO_DATAGRAM_QUEUE messages.
+         *
+         * @note \c _oerror._flags.overflow is set, and the message is left
+         * open (to be committed again later), if it is longer than the MTU
+         * or no more messages can be held.
+         *
+         * @returns \c true if the message was committed.
+         */
+        bool commit() {
+            size_t n = _obuf.in_avail() - _committed;
+            if (n > _mtu) {
+                _oerror._flags.overflow = true;
+                return false;
+            }
+            if (_ocount == UIO_DATAGRAM_QUEUE) {
+                flush();
+                if (_ocount == UIO_DATAGRAM_QUEUE) {
+                    _oerror._flags.overflow = true;
+                    return false;
+                }
+            }
+            _olen[(_ohead + _ocount++) % UIO_DATAGRAM_QUEUE] = (uint16_t) n;
+            _committed += n;
+            return true;
+        }
+
+        /**
+         * @brief Send each committed message as one datagram.
+         *
+         * Messages that the transport does not take are kept for the next
+         * flush, and a message that has not been committed is not sent.
+         *
+         * @returns \c *this
+         */
+        virtual ostream& flush() {
+            bool sent = false;
+            while (_ocount) {
+                size_t n = _olen[_ohead];
+                if (!send_datagram(_obuf.gptr(), n)) {
+                    break;
+                }
+                _obuf.gbump(n);
+                _committed -= n;
+                _ohead = (_ohead + 1) % UIO_DATAGRAM_QUEUE;
+                --_ocount;
+                sent = true;
+            }
+            if (sent) {
+                _obuf.compact();
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Receive datagrams into the input buffer.
+         *
+         * Datagrams are received while there is room for one of the MTU.
+         *
+         * @attention The message from \ref get_message is moved, so it
+         * must not be used after this call.
+         *
+         * @returns \c *this
+         */
+        virtual istream& sync() {
+            if (_ibuf._error._flags.uninitialized) {
+                return *this;
+            }
+            _ibuf.compact();
+            while (_icount < UIO_DATAGRAM_QUEUE
+                && (size_t) (_ibuf.epptr() - _ibuf.pptr()) >= _mtu) {
+                size_t n;
+                if (!recv_datagram(_ibuf.pptr(), _mtu, &n)) {
+                    break;
+                }
+                if (n > _mtu) {
+                    ++_dropped;
+                    _ierror._flags.overflow = true;
+                    continue;
+                }
+                _ibuf.pbump(n);
+                _ilen[(_ihead + _icount++) % UIO_DATAGRAM_QUEUE] = (uint16_t) n;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Get the next message.
+         *
+         * The previous message is released first. The stream is synced (at
+         * most once) if no message has been received.
+         *
+         * @param[out] msg The message, in the input buffer. It stays valid
+         * until it is released.
+         * @param[out] len The length of the message.
+         *
+         * @returns \c true if a message was received.
+         */
+        bool get_message(const char** msg, size_t* len) {
+            release();
+            if (!_icount) {
+                sync();
+                if (!_icount) {
+                    return false;
+                }
+            }
+            *msg = _ibuf.gptr();
+            *len = _ilen[_ihead];
+            _held = *len;
+            _ihead = (_ihead + 1) % UIO_DATAGRAM_QUEUE;
+            --_icount;
+            return true;
+        }
+
+        /**
+         * @brief Release the last message's space in the input buffer.
+         */
+        void release() {
+            _ibuf.gbump(_held);
+            _held = 0;
+        }
+
+        /**
+         * @brief Get the number of datagrams that have been dropped.
+         *
+         * @returns The number of datagrams longer than the MTU.
+         */
+        inline uint32_t dropped() const {
+            return _dropped;
+        }
+
+    protected:
+        /**
+         * @brief Pure virtual function to send a datagram.
+         *
+         * @param[in] s The address of the first byte.
+         * @param[in] n The number of bytes.
+         *
+         * @returns \c true if the datagram was sent, or \c false if the
+         * transport can not take it now.
+         */
+        virtual bool send_datagram(const char* s, size_t n) = 0;
+
+        /**
+         * @brief Pure virtual function to receive a datagram.
+         *
+         * @param[out] buf Memory for the datagram.
+         * @param[in] cap The size of \a buf.
+         * @param[out] len The length of the datagram, or any value greater
+         * than \a cap if it did not fit (it is dropped).
+         *
+         * @returns \c true if a datagram was received, or \c false if none
+         * is waiting.
+         */
+        virtual bool recv_datagram(char* buf, size_t cap, size_t* len) = 0;
+
+    private:
+        size_t _mtu;
+        uint16_t _ilen[UIO_DATAGRAM_QUEUE];
+        size_t _ihead;
+        size_t _icount;
+        size_t _held;       // length of the message from get_message
+        uint16_t _olen[UIO_DATAGRAM_QUEUE];
+        size_t _ohead;
+        size_t _ocount;
+        size_t _committed;  // bytes in committed messages
+        uint32_t _dropped;
+    };
+
+#if defined(__unix__) || defined(__APPLE__)
+    /**
+     * @brief A \ref datagram_iostream on a connected socket (e.g. UDP,
+     * \c SOCK_SEQPACKET or SocketCAN).
+     *
+     * Sends and receives do not block.
+     */
+    class socket_datagram_iostream : public datagram_iostream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] fd The connected socket.
+         * @param[in] mtu The largest datagram (at most 65535 bytes).
+         */
+        socket_datagram_iostream(int fd, size_t mtu)
+            : datagram_iostream(mtu), _fd(fd) {}
+
+    protected:
+        virtual bool send_datagram(const char* s, size_t n) {
+            return send(_fd, s, n, MSG_DONTWAIT) == (ssize_t) n;
+        }
+
+        virtual bool recv_datagram(char* buf, size_t cap, size_t* len) {
+            struct iovec iov;
+            iov.iov_base = buf;
+            iov.iov_len = cap;
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = &iov;
+            msg.msg_iovlen = 1;
+            ssize_t r = recvmsg(_fd, &msg, MSG_DONTWAIT);
+            if (r < 0) {
+                return false;
+            }
+            *len = (msg.msg_flags & MSG_TRUNC) ? cap + 1 : (size_t) r;
+            return true;
+        }
+
+    private:
+        int _fd;
+    };
+#endif
+};
+
+#endif // UIO_DATAGRAM_H
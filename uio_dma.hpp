@@ -0,0 +1,429 @@
+#ifndef UIO_DMA_H
+#define UIO_DMA_H
+/**
+ * @file
+ * @brief DMA-driven streams and a simulated DMA controller.
+ *
+ * \par
+ * A \ref uio::dma_istream has a DMA channel fill the free region of its
+ * input buffer, and a \ref uio::dma_ostream has a DMA channel drain the
+ * buffered region of its output buffer, so no bytes are copied by the CPU.
+ * While a transfer is in flight the application keeps reading (or
+ * writing) the rest of the buffer, which gives double-buffered operation.
+ *
+ * \par
+ * On POSIX hosts, \ref uio::sim_dma simulates a DMA controller on a helper
+ * thread so that these paths can be developed and benchmarked off-target.
+ */
+#include "uio.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <pthread.h>
+#include <time.h>
+#endif
+
+namespace uio {
+
+    class dma_channel;
+
+    /**
+     * @brief Receiver of DMA transfer events.
+     *
+     * The events are raised from the DMA controller's interrupt (or the
+     * simulator's helper thread), so handlers must be short and must not
+     * touch the stream buffers.
+     */
+    class dma_handler {
+    public:
+        virtual ~dma_handler() {}
+
+        /**
+         * @brief Half of the transfer has completed.
+         */
+        virtual void dma_half(dma_channel& ch) {
+            (void) ch;
+        }
+
+        /**
+         * @brief The whole transfer has completed.
+         */
+        virtual void dma_complete(dma_channel& ch) {
+            (void) ch;
+        }
+    };
+
+    /**
+     * @brief A DMA channel between memory and a peripheral.
+     *
+     * The direction of a channel is fixed by the peripheral it is wired to.
+     * Derived classes implement the channel for a DMA controller.
+     */
+    class dma_channel {
+    public:
+        dma_channel() {
+            _handler = NULL;
+        }
+
+        virtual ~dma_channel() {}
+
+        /**
+         * @brief Set the receiver of the channel's transfer events.
+         *
+         * @param[in] h The handler, or \c NULL for no events.
+         */
+        inline void handler(dma_handler* h) {
+            _handler = h;
+        }
+
+        /**
+         * @brief Pure virtual function to start a transfer.
+         *
+         * @param[in] mem The memory to transfer to (or from).
+         * @param[in] len The number of bytes to transfer.
+         *
+         * @returns \c true if the transfer was started (i.e. the channel
+         * was idle).
+         */
+        virtual bool start(char* mem, size_t len) = 0;
+
+        /**
+         * @brief Pure virtual function to get the number of bytes that the
+         * current transfer has yet to move.
+         *
+         * @returns The remaining length of the transfer, or 0 if the channel
+         * is idle.
+         */
+        virtual size_t remaining() = 0;
+
+        /**
+         * @brief Pure virtual function to abort the current transfer.
+         */
+        virtual void stop() = 0;
+
+    protected:
+        dma_handler* _handler; ///< Receiver of transfer events.
+    };
+
+    /**
+     * @brief An input stream whose buffer is filled by DMA.
+     *
+     * \ref sync appends the bytes the channel has moved so far and, once
+     * the transfer has completed, starts the next transfer into the free
+     * region of the input buffer.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class dma_istream : public istream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] ch The channel that receives from the peripheral.
+         * @param[in] chunk The largest transfer to start.
+         */
+        dma_istream(dma_channel& ch, size_t chunk) : _ch(ch) {
+            _chunk = chunk;
+            _len = 0;
+            _done = 0;
+        }
+
+        virtual ~dma_istream() {
+            _ch.stop();
+        }
+
+        /**
+         * @brief Initialize the input buffer.
+         *
+         * @param buf Memory allocation for the input buffer.
+         * @param capacity Size of the buffer.
+         *
+         * @returns \c this
+         */
+        dma_istream* setbuf(char* buf, size_t capacity) {
+            _ch.stop();
+            _len = 0;
+            _done = 0;
+            _ibuf.setbuf(buf, capacity);
+            return this;
+        }
+
+        virtual istream& sync() {
+            if (_ibuf._error._flags.uninitialized) {
+                return *this;
+            }
+            size_t remaining = _len ? _ch.remaining() : 0;
+            _ibuf.pbump(_len - remaining - _done);
+            _done = _len - remaining;
+            if (!remaining) {
+                _ibuf.compact();
+                char* p = _ibuf.pptr();
+                _len = min((size_t) (_ibuf.epptr() - p), _chunk);
+                _done = 0;
+                if (_len && !_ch.start(p, _len)) {
+                    _len = 0;
+                }
+            }
+            return *this;
+        }
+
+    private:
+        dma_channel& _ch;
+        size_t _chunk;
+        size_t _len;
+        size_t _done;
+    };
+
+    /**
+     * @brief An output stream whose buffer is drained by DMA.
+     *
+     * \ref flush releases the bytes the channel has moved so far and, once
+     * the transfer has completed, starts a transfer of everything that has
+     * been buffered since. Bytes can be written while a transfer is in
+     * flight.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class dma_ostream : public ostream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] ch The channel that transmits to the peripheral.
+         */
+        explicit dma_ostream(dma_channel& ch) : _ch(ch) {
+            _len = 0;
+            _done = 0;
+        }
+
+        virtual ~dma_ostream() {
+            _ch.stop();
+        }
+
+        /**
+         * @brief Initialize the output buffer.
+         *
+         * @param buf Memory allocation for the output buffer.
+         * @param capacity Size of the buffer.
+         *
+         * @returns \c this
+         */
+        dma_ostream* setbuf(char* buf, size_t capacity) {
+            _ch.stop();
+            _len = 0;
+            _done = 0;
+            _obuf.setbuf(buf, capacity);
+            return this;
+        }
+
+        virtual ostream& flush() {
+            if (_obuf._error._flags.uninitialized) {
+                return *this;
+            }
+            size_t remaining = _len ? _ch.remaining() : 0;
+            _obuf.gbump(_len - remaining - _done);
+            _done = _len - remaining;
+            if (!remaining) {
+                _obuf.compact();
+                _len = _obuf.in_avail();
+                _done = 0;
+                if (_len && !_ch.start(_obuf.gptr(), _len)) {
+                    _len = 0;
+                }
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Check whether a transfer is in flight.
+         *
+         * @returns \c true if the channel is still draining the buffer.
+         */
+        inline bool busy() {
+            return _len && _ch.remaining();
+        }
+
+    private:
+        dma_channel& _ch;
+        size_t _len;
+        size_t _done;
+    };
+
+#if defined(__unix__) || defined(__APPLE__)
+    /**
+     * @brief A simulated peripheral for a \ref sim_dma channel.
+     */
+    class sim_peripheral {
+    public:
+        virtual ~sim_peripheral() {}
+
+        /**
+         * @brief Pure virtual function to move bytes to (or from) the
+         * peripheral.
+         *
+         * For a receive channel the peripheral fills \a mem; for a transmit
+         * channel it consumes \a mem. This is called from the helper thread
+         * of the channel, if it runs one.
+         *
+         * @param[in,out] mem The memory to transfer.
+         * @param[in] n The number of bytes in the burst.
+         *
+         * @returns The number of bytes the peripheral moved (fewer than
+         * \a n if it is not ready).
+         */
+        virtual size_t transfer(char* mem, size_t n) = 0;
+    };
+
+    /**
+     * @brief A simulated DMA controller channel.
+     *
+     * Transfers move \c burst bytes at a time between memory and a
+     * \ref sim_peripheral, raising the half-transfer and transfer-complete
+     * events like a DMA controller. Bursts are moved by \ref step, either
+     * called directly (for deterministic tests) or from a helper thread
+     * started with \ref run.
+     *
+     * @attention The peripheral \em must outlive the channel. The helper
+     * thread is stopped by the destructor.
+     */
+    class sim_dma : public dma_channel {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] p The peripheral that the channel is wired to.
+         * @param[in] burst The number of bytes moved per step.
+         */
+        sim_dma(sim_peripheral& p, size_t burst) : _peripheral(p) {
+            _burst = burst ? burst : 1;
+            _mem = NULL;
+            _len = 0;
+            _pos = 0;
+            _half = false;
+            _running = false;
+            pthread_mutex_init(&_lock, NULL);
+        }
+
+        virtual ~sim_dma() {
+            halt();
+            pthread_mutex_destroy(&_lock);
+        }
+
+        virtual bool start(char* mem, size_t len) {
+            pthread_mutex_lock(&_lock);
+            bool idle = (_pos == _len);
+            if (idle) {
+                _mem = mem;
+                _len = len;
+                _pos = 0;
+                _half = false;
+            }
+            pthread_mutex_unlock(&_lock);
+            return idle;
+        }
+
+        virtual size_t remaining() {
+            pthread_mutex_lock(&_lock);
+            size_t n = _len - _pos;
+            pthread_mutex_unlock(&_lock);
+            return n;
+        }
+
+        virtual void stop() {
+            pthread_mutex_lock(&_lock);
+            _len = _pos;
+            pthread_mutex_unlock(&_lock);
+        }
+
+        /**
+         * @brief Move one burst and raise any events it triggers.
+         *
+         * @returns The number of bytes moved.
+         */
+        size_t step() {
+            pthread_mutex_lock(&_lock);
+            char* mem = _mem + _pos;
+            size_t n = min(_burst, _len - _pos);
+            n = n ? _peripheral.transfer(mem, n) : 0;
+            _pos += n;
+            bool half = !_half && n && _pos >= _len / 2;
+            bool complete = n && _pos == _len;
+            _half = _half || half;
+            pthread_mutex_unlock(&_lock);
+
+            // raise events outside the lock, like an interrupt would
+            if (_handler && half) {
+                _handler->dma_half(*this);
+            }
+            if (_handler && complete) {
+                _handler->dma_complete(*this);
+            }
+            return n;
+        }
+
+        /**
+         * @brief Start a helper thread that moves one burst per \a period.
+         *
+         * @param[in] period Time between bursts, in nanoseconds.
+         *
+         * @returns \c true if the thread was started.
+         */
+        bool run(long period) {
+            if (_running) {
+                return false;
+            }
+            _period = period;
+            _running = true;
+            if (pthread_create(&_thread, NULL, &sim_dma::loop, this)) {
+                _running = false;
+            }
+            return _running;
+        }
+
+        /**
+         * @brief Stop the helper thread.
+         */
+        void halt() {
+            if (_running) {
+                pthread_mutex_lock(&_lock);
+                _running = false;
+                pthread_mutex_unlock(&_lock);
+                pthread_join(_thread, NULL);
+            }
+        }
+
+    private:
+        static void* loop(void* arg) {
+            sim_dma* self = (sim_dma*) arg;
+            struct timespec ts;
+            ts.tv_sec = self->_period / 1000000000L;
+            ts.tv_nsec = self->_period % 1000000000L;
+            for (;;) {
+                pthread_mutex_lock(&self->_lock);
+                bool running = self->_running;
+                pthread_mutex_unlock(&self->_lock);
+                if (!running) {
+                    break;
+                }
+                self->step();
+                nanosleep(&ts, NULL);
+            }
+            return NULL;
+        }
+
+        sim_peripheral& _peripheral;
+        size_t _burst;
+        char* _mem;
+        size_t _len;
+        size_t _pos;
+        bool _half;
+        bool _running;
+        long _period;
+        pthread_t _thread;
+        pthread_mutex_t _lock;
+    };
+#endif
+};
+
+#endif // UIO_DMA_H
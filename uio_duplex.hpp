@@ -0,0 +1,167 @@
+#ifndef UIO_DUPLEX_H
+#define UIO_DUPLEX_H
+/**
+ * @file
+ * @brief Full-duplex streams that share one buffer.
+ */
+#include "uio.hpp"
+
+namespace uio {
+
+    /**
+     * @brief An input and output data stream whose input and output buffers
+     * share one memory region.
+     *
+     * The input buffer occupies the front of the region and the output 
+     * buffer the back. Whenever one direction runs out of space, free space
+     * is lent to it by the other direction, down to that direction's 
+     * minimum reservation. Traffic that is mostly one-sided can therefore
+     * use nearly the whole region, so the region can be about half the size
+     * of two worst-case buffers.
+     *
+     * Output space is lent automatically by \ref put, \ref write, 
+     * \ref operator<<, and \ref vprintf. Implementations of \ref sync should call 
+     * \ref reserve_in before putting input data into \c _ibuf.
+     *
+     * @attention Lending space moves buffered data, so pointers into 
+     * \c _ibuf or \c _obuf (e.g. from \c gptr) are invalidated by the calls
+     * above. \ref setbuf \em must be called before this class can be used.
+     */
+    class duplex_iostream : public iostream {
+    public:
+        /**
+         * @brief Default constructor.
+         */
+        duplex_iostream() {
+            _buf = NULL;
+            _imin = 0;
+            _omin = 0;
+        }
+
+        /**
+         * @brief Initialize the shared buffer.
+         * 
+         * The space above both reservations is split evenly to begin with.
+         * 
+         * @param buf Memory allocation for both buffers.
+         * @param capacity Size of \a buf.
+         * @param imin Space always reserved for input data.
+         * @param omin Space always reserved for output data.
+         * 
+         * @returns \c this
+         */
+        duplex_iostream* setbuf(char* buf, size_t capacity, size_t imin,
+            size_t omin) {
+            _buf = buf;
+            _imin = min(imin, capacity);
+            _omin = min(omin, capacity - _imin);
+            size_t split = _imin + (capacity - _imin - _omin) / 2;
+            _ibuf.setbuf(buf, split);
+            _obuf.setbuf(buf ? buf + split : NULL, capacity - split);
+            return this;
+        }
+
+        virtual ostream& operator<<(const char* s) {
+            reserve_out(strlen(s));
+            return ostream::operator<<(s);
+        }
+
+        virtual ostream& put(char c) {
+            reserve_out(1);
+            return ostream::put(c);
+        }
+
+        virtual ostream& write(const char* s, size_t n) {
+            reserve_out(n);
+            return ostream::write(s, n);
+        }
+
+        virtual ostream& vprintf(const char* format, va_list args) {
+            va_list again;
+            UIO_VA_COPY(again, args);
+            int n = vsnprintf(NULL, 0, format, args);
+            if (n >= 0) {
+                reserve_out((size_t) n + 1); // and the null character
+            }
+            ostream::vprintf(format, again);
+            va_end(again);
+            return *this;
+        }
+
+        /**
+         * @brief Make room for \a n more bytes of input data.
+         * 
+         * Free output space is lent to the input buffer if it is needed.
+         * 
+         * @param[in] n The number of bytes to make room for.
+         * 
+         * @returns The free space in the input buffer (which is less than 
+         * \a n if not enough space could be lent).
+         */
+        size_t reserve_in(size_t n) {
+            size_t iused = avail(_ibuf);
+            size_t ifree = _ibuf.capacity() - iused;
+            if (ifree >= n || !_buf) {
+                return ifree;
+            }
+
+            size_t oused = avail(_obuf);
+            size_t ocap = _obuf.capacity();
+            size_t d = min(n - ifree, ocap - max(_omin, oused));
+            size_t split = _ibuf.capacity() + d;
+            rebase(_obuf, _buf + split, ocap - d, oused);
+            rebase(_ibuf, _buf, split, iused);
+            return ifree + d;
+        }
+
+        /**
+         * @brief Make room for \a n more bytes of output data.
+         * 
+         * Free input space is lent to the output buffer if it is needed.
+         * 
+         * @param[in] n The number of bytes to make room for.
+         * 
+         * @returns The free space in the output buffer (which is less than 
+         * \a n if not enough space could be lent).
+         */
+        size_t reserve_out(size_t n) {
+            size_t oused = avail(_obuf);
+            size_t ofree = _obuf.capacity() - oused;
+            if (ofree >= n || !_buf) {
+                return ofree;
+            }
+
+            size_t iused = avail(_ibuf);
+            size_t icap = _ibuf.capacity();
+            size_t d = min(n - ofree, icap - max(_imin, iused));
+            size_t split = icap - d;
+            rebase(_ibuf, _buf, split, iused);
+            rebase(_obuf, _buf + split, _obuf.capacity() + d, oused);
+            return ofree + d;
+        }
+
+    private:
+        static size_t max(size_t v1, size_t v2) {
+            return v1 < v2 ? v2 : v1;
+        }
+
+        // compact the buffer so that its bytes start at its front
+        static size_t avail(streambuf& sb) {
+            sb.compact();
+            return sb.in_avail();
+        }
+
+        static void rebase(streambuf& sb, char* buf, size_t capacity,
+            size_t n) {
+            memmove(buf, sb.gptr(), n);
+            sb.setbuf(buf, capacity);
+            sb.pbump(n);
+        }
+
+        char* _buf;
+        size_t _imin;
+        size_t _omin;
+    };
+};
+
+#endif // UIO_DUPLEX_H
@@ -0,0 +1,792 @@
+#ifndef UIO_FEC_H
+#define UIO_FEC_H
+/**
+ * @file
+ * @brief Reed-Solomon forward error correction.
+ *
+ * \par
+ * A \ref uio::fec_ostream sends its output in blocks of \c k data rows and
+ * \c m parity rows, each \c width bytes long and followed by a CRC-32C. Each
+ * column of a block is a Reed-Solomon codeword over GF(2^8), so a
+ * \ref uio::fec_istream can repair up to \c m rows that fail their CRC
+ * (erasures), or up to <tt>m / 2</tt> corrupt bytes in each column
+ * wherever they are (errors), without a retransmission.
+ *
+ * \par
+ * Parity, syndromes and erasure repairs are computed a row at a time: each
+ * step multiplies one row by a constant and adds it to another. With SSSE3,
+ * \c PSHUFB looks up the products of 16 bytes at once in two 16-entry
+ * tables (one for each nibble), so each step costs a few instructions per
+ * 16 bytes. Only columns that are still wrong after the erasures have been
+ * repaired are decoded one at a time (with Berlekamp-Massey, a Chien search
+ * and Forney's algorithm).
+ */
+#include <stdint.h>
+#include "uio.hpp"
+#include "uio_crc.hpp"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+#ifndef UIO_FEC_PARITY
+/**
+ * @brief Maximum number of parity rows in a \ref uio::fec_code block.
+ */
+#define UIO_FEC_PARITY 32
+#endif
+
+namespace uio {
+
+    /// \cond DO_NOT_DOCUMENT
+    // GF(2^8) with the polynomial x^8 + x^4 + x^3 + x^2 + 1 (0x11D)
+    inline unsigned char fec_exp(unsigned i) {
+        static const unsigned char table[255] = {
+            0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+            0x1D, 0x3A, 0x74, 0xE8, 0xCD, 0x87, 0x13, 0x26,
+            0x4C, 0x98, 0x2D, 0x5A, 0xB4, 0x75, 0xEA, 0xC9,
+            0x8F, 0x03, 0x06, 0x0C, 0x18, 0x30, 0x60, 0xC0,
+            0x9D, 0x27, 0x4E, 0x9C, 0x25, 0x4A, 0x94, 0x35,
+            0x6A, 0xD4, 0xB5, 0x77, 0xEE, 0xC1, 0x9F, 0x23,
+            0x46, 0x8C, 0x05, 0x0A, 0x14, 0x28, 0x50, 0xA0,
+            0x5D, 0xBA, 0x69, 0xD2, 0xB9, 0x6F, 0xDE, 0xA1,
+            0x5F, 0xBE, 0x61, 0xC2, 0x99, 0x2F, 0x5E, 0xBC,
+            0x65, 0xCA, 0x89, 0x0F, 0x1E, 0x3C, 0x78, 0xF0,
+            0xFD, 0xE7, 0xD3, 0xBB, 0x6B, 0xD6, 0xB1, 0x7F,
+            0xFE, 0xE1, 0xDF, 0xA3, 0x5B, 0xB6, 0x71, 0xE2,
+            0xD9, 0xAF, 0x43, 0x86, 0x11, 0x22, 0x44, 0x88,
+            0x0D, 0x1A, 0x34, 0x68, 0xD0, 0xBD, 0x67, 0xCE,
+            0x81, 0x1F, 0x3E, 0x7C, 0xF8, 0xED, 0xC7, 0x93,
+            0x3B, 0x76, 0xEC, 0xC5, 0x97, 0x33, 0x66, 0xCC,
+            0x85, 0x17, 0x2E, 0x5C, 0xB8, 0x6D, 0xDA, 0xA9,
+            0x4F, 0x9E, 0x21, 0x42, 0x84, 0x15, 0x2A, 0x54,
+            0xA8, 0x4D, 0x9A, 0x29, 0x52, 0xA4, 0x55, 0xAA,
+            0x49, 0x92, 0x39, 0x72, 0xE4, 0xD5, 0xB7, 0x73,
+            0xE6, 0xD1, 0xBF, 0x63, 0xC6, 0x91, 0x3F, 0x7E,
+            0xFC, 0xE5, 0xD7, 0xB3, 0x7B, 0xF6, 0xF1, 0xFF,
+            0xE3, 0xDB, 0xAB, 0x4B, 0x96, 0x31, 0x62, 0xC4,
+            0x95, 0x37, 0x6E, 0xDC, 0xA5, 0x57, 0xAE, 0x41,
+            0x82, 0x19, 0x32, 0x64, 0xC8, 0x8D, 0x07, 0x0E,
+            0x1C, 0x38, 0x70, 0xE0, 0xDD, 0xA7, 0x53, 0xA6,
+            0x51, 0xA2, 0x59, 0xB2, 0x79, 0xF2, 0xF9, 0xEF,
+            0xC3, 0x9B, 0x2B, 0x56, 0xAC, 0x45, 0x8A, 0x09,
+            0x12, 0x24, 0x48, 0x90, 0x3D, 0x7A, 0xF4, 0xF5,
+            0xF7, 0xF3, 0xFB, 0xEB, 0xCB, 0x8B, 0x0B, 0x16,
+            0x2C, 0x58, 0xB0, 0x7D, 0xFA, 0xE9, 0xCF, 0x83,
+            0x1B, 0x36, 0x6C, 0xD8, 0xAD, 0x47, 0x8E
+        };
+        return table[i % 255];
+    }
+
+    inline unsigned fec_log(unsigned char x) {
+        static const unsigned char table[256] = {
+            0x00, 0x00, 0x01, 0x19, 0x02, 0x32, 0x1A, 0xC6,
+            0x03, 0xDF, 0x33, 0xEE, 0x1B, 0x68, 0xC7, 0x4B,
+            0x04, 0x64, 0xE0, 0x0E, 0x34, 0x8D, 0xEF, 0x81,
+            0x1C, 0xC1, 0x69, 0xF8, 0xC8, 0x08, 0x4C, 0x71,
+            0x05, 0x8A, 0x65, 0x2F, 0xE1, 0x24, 0x0F, 0x21,
+            0x35, 0x93, 0x8E, 0xDA, 0xF0, 0x12, 0x82, 0x45,
+            0x1D, 0xB5, 0xC2, 0x7D, 0x6A, 0x27, 0xF9, 0xB9,
+            0xC9, 0x9A, 0x09, 0x78, 0x4D, 0xE4, 0x72, 0xA6,
+            0x06, 0xBF, 0x8B, 0x62, 0x66, 0xDD, 0x30, 0xFD,
+            0xE2, 0x98, 0x25, 0xB3, 0x10, 0x91, 0x22, 0x88,
+            0x36, 0xD0, 0x94, 0xCE, 0x8F, 0x96, 0xDB, 0xBD,
+            0xF1, 0xD2, 0x13, 0x5C, 0x83, 0x38, 0x46, 0x40,
+            0x1E, 0x42, 0xB6, 0xA3, 0xC3, 0x48, 0x7E, 0x6E,
+            0x6B, 0x3A, 0x28, 0x54, 0xFA, 0x85, 0xBA, 0x3D,
+            0xCA, 0x5E, 0x9B, 0x9F, 0x0A, 0x15, 0x79, 0x2B,
+            0x4E, 0xD4, 0xE5, 0xAC, 0x73, 0xF3, 0xA7, 0x57,
+            0x07, 0x70, 0xC0, 0xF7, 0x8C, 0x80, 0x63, 0x0D,
+            0x67, 0x4A, 0xDE, 0xED, 0x31, 0xC5, 0xFE, 0x18,
+            0xE3, 0xA5, 0x99, 0x77, 0x26, 0xB8, 0xB4, 0x7C,
+            0x11, 0x44, 0x92, 0xD9, 0x23, 0x20, 0x89, 0x2E,
+            0x37, 0x3F, 0xD1, 0x5B, 0x95, 0xBC, 0xCF, 0xCD,
+            0x90, 0x87, 0x97, 0xB2, 0xDC, 0xFC, 0xBE, 0x61,
+            0xF2, 0x56, 0xD3, 0xAB, 0x14, 0x2A, 0x5D, 0x9E,
+            0x84, 0x3C, 0x39, 0x53, 0x47, 0x6D, 0x41, 0xA2,
+            0x1F, 0x2D, 0x43, 0xD8, 0xB7, 0x7B, 0xA4, 0x76,
+            0xC4, 0x17, 0x49, 0xEC, 0x7F, 0x0C, 0x6F, 0xF6,
+            0x6C, 0xA1, 0x3B, 0x52, 0x29, 0x9D, 0x55, 0xAA,
+            0xFB, 0x60, 0x86, 0xB1, 0xBB, 0xCC, 0x3E, 0x5A,
+            0xCB, 0x59, 0x5F, 0xB0, 0x9C, 0xA9, 0xA0, 0x51,
+            0x0B, 0xF5, 0x16, 0xEB, 0x7A, 0x75, 0x2C, 0xD7,
+            0x4F, 0xAE, 0xD5, 0xE9, 0xE6, 0xE7, 0xAD, 0xE8,
+            0x74, 0xD6, 0xF4, 0xEA, 0xA8, 0x50, 0x58, 0xAF
+        };
+        return table[x];
+    }
+
+    inline unsigned char fec_mul(unsigned char a, unsigned char b) {
+        return a && b ? fec_exp(fec_log(a) + fec_log(b)) : 0;
+    }
+
+    inline unsigned char fec_inv(unsigned char a) {
+        return fec_exp(255 - fec_log(a));
+    }
+
+    // dst ^= c * src, for n bytes
+    inline void fec_mac(unsigned char c, const char* src, char* dst,
+        size_t n) {
+        if (!c) {
+            return;
+        }
+        unsigned char lo[16];
+        unsigned char hi[16];
+        for (unsigned x = 0; x < 16; ++x) {
+            lo[x] = fec_mul(c, (unsigned char) x);
+            hi[x] = fec_mul(c, (unsigned char) (x << 4));
+        }
+        size_t i = 0;
+#if defined(__SSSE3__)
+        const __m128i tlo = _mm_loadu_si128((const __m128i*) lo);
+        const __m128i thi = _mm_loadu_si128((const __m128i*) hi);
+        const __m128i mask = _mm_set1_epi8(0x0F);
+        for (; i + 16 <= n; i += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i*) (src + i));
+            __m128i p = _mm_xor_si128(
+                _mm_shuffle_epi8(tlo, _mm_and_si128(v, mask)),
+                _mm_shuffle_epi8(thi,
+                    _mm_and_si128(_mm_srli_epi64(v, 4), mask)));
+            __m128i d = _mm_loadu_si128((const __m128i*) (dst + i));
+            _mm_storeu_si128((__m128i*) (dst + i), _mm_xor_si128(d, p));
+        }
+#else
+        if (n >= 256) {
+            unsigned char table[256];
+            for (unsigned x = 0; x < 256; ++x) {
+                table[x] = lo[x & 0xF] ^ hi[x >> 4];
+            }
+            for (; i < n; ++i) {
+                dst[i] ^= (char) table[(unsigned char) src[i]];
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            unsigned char s = (unsigned char) src[i];
+            dst[i] ^= (char) (lo[s & 0xF] ^ hi[s >> 4]);
+        }
+    }
+    /// \endcond
+
+    /**
+     * @brief A Reed-Solomon code over blocks of rows.
+     *
+     * A block is \c k data rows followed by \c m parity rows. Each row is
+     * \c width bytes followed by their CRC-32C (least significant byte
+     * first), and column \c j of the block (byte \c j of every row,
+     * first row first) is a codeword whose generator polynomial has the
+     * roots 1, a, ..., a^(m-1), where a is 2 in GF(2^8) with the
+     * polynomial 0x11D.
+     *
+     * @attention \c k + \c m \em must not be greater than 255, and \c m
+     * \em must be from 1 to \ref UIO_FEC_PARITY.
+     */
+    class fec_code {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] k The number of data rows.
+         * @param[in] m The number of parity rows.
+         * @param[in] width The number of bytes in each row, not counting
+         * its CRC.
+         */
+        fec_code(size_t k, size_t m, size_t width)
+            : _k(k), _m(m), _width(width) {
+            // g(x) = (x + 1)(x + a)...(x + a^(m-1)), lowest term first
+            _gen[0] = 1;
+            for (size_t j = 0; j < m; ++j) {
+                unsigned char root = fec_exp(j);
+                _gen[j + 1] = 0;
+                for (size_t i = j + 1; i > 0; --i) {
+                    _gen[i] = _gen[i - 1] ^ fec_mul(_gen[i], root);
+                }
+                _gen[0] = fec_mul(_gen[0], root);
+            }
+        }
+
+        /**
+         * @brief Get the number of data rows.
+         *
+         * @returns \c k
+         */
+        inline size_t k() const {
+            return _k;
+        }
+
+        /**
+         * @brief Get the number of bytes in each row.
+         *
+         * @returns \c width
+         */
+        inline size_t width() const {
+            return _width;
+        }
+
+        /**
+         * @brief Get the distance between rows.
+         *
+         * @returns \c width plus the CRC.
+         */
+        inline size_t stride() const {
+            return _width + 4;
+        }
+
+        /**
+         * @brief Get the size of a block.
+         *
+         * @returns The number of bytes in \c k + \c m rows.
+         */
+        inline size_t size() const {
+            return (_k + _m) * stride();
+        }
+
+        /**
+         * @brief Compute the parity rows and the CRC of every row.
+         *
+         * @param[in,out] block The block, whose data rows are filled in.
+         */
+        void encode(char* block) const {
+            const size_t stride = this->stride();
+            char* parity = block + _k * stride;
+            for (size_t r = 0; r < _m; ++r) {
+                memset(parity + r * stride, 0, _width);
+            }
+
+            // data row i is the x^(m + k - 1 - i) term, so it adds
+            // x^(m + k - 1 - i) mod g(x), times itself, to the parity
+            unsigned char rem[UIO_FEC_PARITY];
+            memcpy(rem, _gen, _m);
+            for (size_t i = _k; i--; ) {
+                const char* d = block + i * stride;
+                for (size_t r = 0; r < _m; ++r) {
+                    fec_mac(rem[_m - 1 - r], d, parity + r * stride, _width);
+                }
+                unsigned char top = rem[_m - 1];
+                for (size_t t = _m - 1; t > 0; --t) {
+                    rem[t] = rem[t - 1] ^ fec_mul(top, _gen[t]);
+                }
+                rem[0] = fec_mul(top, _gen[0]);
+            }
+
+            for (size_t i = 0; i < _k + _m; ++i) {
+                char* r = block + i * stride;
+                uint32_t crc = crc32c(r, _width);
+                for (size_t b = 0; b < 4; ++b) {
+                    r[_width + b] = (char) (crc >> (8 * b));
+                }
+            }
+        }
+
+        /**
+         * @brief Repair a block in place.
+         *
+         * A block whose rows all pass their CRC is taken as it is. Otherwise,
+         * rows that fail their CRC are repaired as erasures if there are no
+         * more than \c m of them. Any column that is still not a codeword
+         * is then repaired on its own, as long as twice its errors plus its
+         * erasures are no more than \c m (or, failing that, its errors
+         * alone are no more than <tt>m / 2</tt>). The CRCs of repaired rows
+         * are not updated.
+         *
+         * @param[in,out] block The block.
+         * @param[out] scratch Memory for \c m * \c width bytes of
+         * syndromes.
+         *
+         * @returns The number of rows that failed their CRC, or -1 if the
+         * block could not be repaired.
+         */
+        int decode(char* block, char* scratch) const {
+            const size_t n = _k + _m;
+            const size_t stride = this->stride();
+            unsigned char erased[UIO_FEC_PARITY];
+            size_t f = 0;
+            for (size_t i = 0; i < n; ++i) {
+                const char* r = block + i * stride;
+                uint32_t crc = 0;
+                for (size_t b = 0; b < 4; ++b) {
+                    crc |= (uint32_t) (unsigned char) r[_width + b] << (8 * b);
+                }
+                if (crc32c(r, _width) != crc) {
+                    if (f < _m) {
+                        erased[f] = (unsigned char) i;
+                    }
+                    ++f;
+                }
+            }
+            if (!f) {
+                return 0;
+            }
+
+            // syndrome j is the block's columns evaluated at a^j
+            for (size_t j = 0; j < _m; ++j) {
+                memset(scratch + j * _width, 0, _width);
+            }
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t j = 0; j < _m; ++j) {
+                    fec_mac(fec_exp(j * (n - 1 - i)), block + i * stride,
+                        scratch + j * _width, _width);
+                }
+            }
+
+            unsigned char inv[UIO_FEC_PARITY][UIO_FEC_PARITY];
+            size_t e = f <= _m ? f : 0;
+            char* check = scratch;
+            size_t checks = _m;
+            if (e) {
+                solve(erased, e, inv);
+                repair(block, scratch, erased, e, inv);
+                if (e == _m) {
+                    return (int) f;
+                }
+                remaining(scratch, erased, e, inv);
+                check = scratch + e * _width;
+                checks = _m - e;
+            }
+
+            // any column with a nonzero (remaining) syndrome has errors
+            for (size_t j = 1; j < checks; ++j) {
+                const char* s = check + j * _width;
+                for (size_t c = 0; c < _width; ++c) {
+                    check[c] |= s[c];
+                }
+            }
+            for (size_t c = 0; c < _width; ++c) {
+                if (check[c] && !correct(block, scratch, c, erased, e, inv)) {
+                    return -1;
+                }
+            }
+            return (int) f;
+        }
+
+    private:
+        // the inverse of the Vandermonde matrix V[j][l] = x[l]^j, where x[l]
+        // is the erased row's locator: row l holds the coefficients of the
+        // Lagrange polynomial p(x) / ((x + x[l]) * prod(x[l] + x[q], q != l)),
+        // where p(x) = prod(x + x[q])
+        void solve(const unsigned char* erased, size_t f,
+            unsigned char inv[][UIO_FEC_PARITY]) const {
+            const size_t n = _k + _m;
+            unsigned char x[UIO_FEC_PARITY];
+            unsigned char p[UIO_FEC_PARITY + 1];
+            p[0] = 1;
+            for (size_t l = 0; l < f; ++l) {
+                x[l] = fec_exp(n - 1 - erased[l]);
+                p[l + 1] = 0;
+                for (size_t i = l + 1; i > 0; --i) {
+                    p[i] = p[i - 1] ^ fec_mul(p[i], x[l]);
+                }
+                p[0] = fec_mul(p[0], x[l]);
+            }
+            for (size_t l = 0; l < f; ++l) {
+                unsigned char q[UIO_FEC_PARITY];
+                q[f - 1] = p[f];
+                for (size_t t = f - 1; t > 0; --t) {
+                    q[t - 1] = p[t] ^ fec_mul(x[l], q[t]);
+                }
+                unsigned char d = 0;
+                for (size_t t = f; t--; ) {
+                    d = fec_mul(d, x[l]) ^ q[t];
+                }
+                d = fec_inv(d);
+                for (size_t t = 0; t < f; ++t) {
+                    inv[l][t] = fec_mul(q[t], d);
+                }
+            }
+        }
+
+        // add the solution of the first f syndromes to the f erased rows
+        // (so doing it twice undoes it)
+        void repair(char* block, const char* syndromes,
+            const unsigned char* erased, size_t f,
+            unsigned char inv[][UIO_FEC_PARITY]) const {
+            for (size_t l = 0; l < f; ++l) {
+                for (size_t t = 0; t < f; ++t) {
+                    fec_mac(inv[l][t], syndromes + t * _width,
+                        block + erased[l] * stride(), _width);
+                }
+            }
+        }
+
+        // turn the other syndromes into those of the repaired block
+        void remaining(char* syndromes, const unsigned char* erased,
+            size_t f, unsigned char inv[][UIO_FEC_PARITY]) const {
+            const size_t n = _k + _m;
+            for (size_t j = f; j < _m; ++j) {
+                for (size_t t = 0; t < f; ++t) {
+                    unsigned char c = 0;
+                    for (size_t l = 0; l < f; ++l) {
+                        c ^= fec_mul(fec_exp((n - 1 - erased[l]) * j),
+                            inv[l][t]);
+                    }
+                    fec_mac(c, syndromes + t * _width,
+                        syndromes + j * _width, _width);
+                }
+            }
+        }
+
+        // decode column c with its repaired erasures, or failing that, undo
+        // their repair and decode it without them
+        bool correct(char* block, const char* syndromes, size_t c,
+            const unsigned char* erased, size_t f,
+            unsigned char inv[][UIO_FEC_PARITY]) const {
+            const size_t n = _k + _m;
+            unsigned char col[255];
+            for (size_t i = 0; i < n; ++i) {
+                col[i] = (unsigned char) block[i * stride() + c];
+            }
+            bool ok = errata(col, erased, f);
+            if (!ok && f) {
+                for (size_t l = 0; l < f; ++l) {
+                    for (size_t t = 0; t < f; ++t) {
+                        col[erased[l]] ^= fec_mul(inv[l][t],
+                            (unsigned char) syndromes[t * _width + c]);
+                    }
+                }
+                ok = errata(col, NULL, 0);
+            }
+            if (ok) {
+                for (size_t i = 0; i < n; ++i) {
+                    block[i * stride() + c] = (char) col[i];
+                }
+            }
+            return ok;
+        }
+
+        // errors-and-erasures decoding of a column in place
+        bool errata(unsigned char* col, const unsigned char* erased,
+            size_t f) const {
+            const size_t n = _k + _m;
+            unsigned char fix[255];
+            memcpy(fix, col, n);
+            unsigned char s[UIO_FEC_PARITY];
+            if (syndromes(fix, s)) {
+                return true;
+            }
+
+            // Berlekamp-Massey, starting from the erasure locator
+            unsigned char lam[UIO_FEC_PARITY + 1];
+            unsigned char old[UIO_FEC_PARITY + 2];
+            size_t llen = 1;
+            lam[0] = 1;
+            for (size_t l = 0; l < f; ++l) {
+                unsigned char x = fec_exp(n - 1 - erased[l]);
+                lam[llen++] = 0;
+                for (size_t i = llen - 1; i > 0; --i) {
+                    lam[i] ^= fec_mul(lam[i - 1], x);
+                }
+            }
+            size_t olen = llen;
+            memcpy(old, lam, llen);
+            for (size_t r = f; r < _m; ++r) {
+                unsigned char delta = s[r];
+                for (size_t j = 1; j < llen && j <= r; ++j) {
+                    delta ^= fec_mul(lam[j], s[r - j]);
+                }
+                memmove(old + 1, old, olen++);
+                old[0] = 0;
+                if (!delta) {
+                    continue;
+                }
+                if (olen > llen) {
+                    unsigned char prev[UIO_FEC_PARITY + 1];
+                    size_t plen = llen;
+                    memcpy(prev, lam, llen);
+                    for (size_t i = 0; i < olen; ++i) {
+                        lam[i] = (i < llen ? lam[i] : 0)
+                            ^ fec_mul(old[i], delta);
+                    }
+                    llen = olen;
+                    unsigned char di = fec_inv(delta);
+                    for (size_t i = 0; i < plen; ++i) {
+                        old[i] = fec_mul(prev[i], di);
+                    }
+                    olen = plen;
+                } else {
+                    for (size_t i = 0; i < olen; ++i) {
+                        lam[i] ^= fec_mul(old[i], delta);
+                    }
+                }
+            }
+            size_t deg = llen - 1;
+            while (deg && !lam[deg]) {
+                --deg;
+            }
+            if (deg < f || 2 * (deg - f) + f > _m) {
+                return false;
+            }
+
+            // omega(x) = s(x) * lambda(x) mod x^m
+            unsigned char om[UIO_FEC_PARITY];
+            for (size_t t = 0; t < _m; ++t) {
+                om[t] = 0;
+                for (size_t j = 0; j <= deg && j <= t; ++j) {
+                    om[t] ^= fec_mul(s[t - j], lam[j]);
+                }
+            }
+
+            // Chien search for the roots 1 / X, and Forney's error values
+            size_t found = 0;
+            for (size_t i = 0; i < n; ++i) {
+                unsigned char x = fec_exp(n - 1 - i);
+                unsigned char xi = fec_inv(x);
+                unsigned char v = 0;
+                for (size_t j = deg + 1; j--; ) {
+                    v = fec_mul(v, xi) ^ lam[j];
+                }
+                if (v) {
+                    continue;
+                }
+                unsigned char num = 0;
+                for (size_t t = _m; t--; ) {
+                    num = fec_mul(num, xi) ^ om[t];
+                }
+                // lambda'(x) has the odd terms of lambda(x), shifted down
+                unsigned char den = 0;
+                unsigned char xi2 = fec_mul(xi, xi);
+                for (size_t t = (deg + 1) / 2; t--; ) {
+                    den = fec_mul(den, xi2) ^ lam[2 * t + 1];
+                }
+                if (!den) {
+                    return false;
+                }
+                fix[i] ^= fec_mul(x, fec_mul(num, fec_inv(den)));
+                ++found;
+            }
+            if (found != deg || !syndromes(fix, s)) {
+                return false;
+            }
+            memcpy(col, fix, n);
+            return true;
+        }
+
+        // true if all the syndromes of a column are zero
+        bool syndromes(const unsigned char* col, unsigned char* s) const {
+            bool zero = true;
+            for (size_t j = 0; j < _m; ++j) {
+                unsigned char a = fec_exp(j);
+                unsigned char v = 0;
+                for (size_t i = 0; i < _k + _m; ++i) {
+                    v = fec_mul(v, a) ^ col[i];
+                }
+                s[j] = v;
+                zero = zero && !v;
+            }
+            return zero;
+        }
+
+        size_t _k;
+        size_t _m;
+        size_t _width;
+        unsigned char _gen[UIO_FEC_PARITY + 1];
+    };
+
+    /**
+     * @brief An output stream that sends blocks with Reed-Solomon parity
+     * over a link.
+     *
+     * \ref flush sends the buffered bytes in blocks of a \ref fec_code,
+     * each holding up to <tt>k * width - 2</tt> bytes (the first two bytes
+     * of the first row are the number of bytes that follow, least
+     * significant byte first). The last block is padded with zeros, so the
+     * stream should be flushed when a block is full or the data is due,
+     * rather than after every write.
+     *
+     * @attention \c k * \c width \em must be from 3 to 65537. \ref setbuf
+     * \em must be called before this class can be used.
+     */
+    class fec_ostream : public ostream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to send blocks on.
+         * @param[in] k The number of data rows in a block.
+         * @param[in] m The number of parity rows in a block.
+         * @param[in] width The number of bytes in each row.
+         */
+        fec_ostream(ostream& link, size_t k, size_t m, size_t width)
+            : _link(link), _code(k, m, width) {}
+
+        /**
+         * @brief Initialize the output buffer.
+         *
+         * @param buf Memory allocation for the output buffer.
+         * @param capacity Size of the buffer.
+         *
+         * @returns \c this
+         */
+        inline fec_ostream* setbuf(char* buf, size_t capacity) {
+            _obuf.setbuf(buf, capacity);
+            return this;
+        }
+
+        /**
+         * @brief Encode the buffered bytes into the link's output buffer and
+         * flush the link.
+         *
+         * @note \c _oerror._flags.overflow is set, and the bytes that have
+         * not been encoded are kept, if the link's output buffer cannot hold
+         * a block after it has been flushed.
+         *
+         * @returns \c *this
+         */
+        virtual ostream& flush() {
+            const size_t stride = _code.stride();
+            const size_t width = _code.width();
+            streambuf& ob = _link.obuf();
+            while (size_t avail = _obuf.in_avail()) {
+                if ((size_t) (ob.epptr() - ob.pptr()) < _code.size()) {
+                    _link.flush();
+                    if ((size_t) (ob.epptr() - ob.pptr()) < _code.size()) {
+                        _oerror._flags.overflow = true;
+                        _oerror |= ob._error;
+                        return *this;
+                    }
+                }
+
+                char* b = ob.pptr();
+                size_t len = min(avail, _code.k() * width - 2);
+                b[0] = (char) len;
+                b[1] = (char) (len >> 8);
+                const char* s = _obuf.gptr();
+                size_t left = len;
+                for (size_t i = 0; i < _code.k(); ++i) {
+                    char* r = b + i * stride + (i ? 0 : 2);
+                    size_t room = width - (i ? 0 : 2);
+                    size_t c = min(room, left);
+                    memcpy(r, s, c);
+                    memset(r + c, 0, room - c);
+                    s += c;
+                    left -= c;
+                }
+                _code.encode(b);
+                ob.pbump(_code.size());
+                _obuf.gbump(len);
+            }
+            _link.flush();
+            return *this;
+        }
+
+    private:
+        ostream& _link;
+        fec_code _code;
+    };
+
+    /**
+     * @brief An input stream that repairs and unpacks the blocks sent by a
+     * \ref fec_ostream.
+     *
+     * Blocks are repaired in place in the link's input buffer, so it
+     * \em must hold a whole block. Blocks that cannot be repaired are
+     * dropped and set \c _ierror._flags.corrupt.
+     *
+     * @note The link must deliver whole blocks, in step with the sender
+     * (e.g. from a reset, or with one block per datagram): a byte that is
+     * lost or inserted, rather than changed, misaligns every later block.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class fec_istream : public istream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to receive blocks from.
+         * @param[in] k The number of data rows in a block.
+         * @param[in] m The number of parity rows in a block.
+         * @param[in] width The number of bytes in each row.
+         */
+        fec_istream(istream& link, size_t k, size_t m, size_t width)
+            : _link(link), _code(k, m, width) {
+            _scratch = NULL;
+            _errors = 0;
+            _repaired = 0;
+        }
+
+        /**
+         * @brief Initialize the input buffer.
+         *
+         * @param buf Memory allocation for the input buffer.
+         * @param capacity Size of the buffer, which \em must be at least
+         * <tt>k * width - 2</tt>.
+         * @param scratch Memory allocation for decoding, of \c m * \c width
+         * bytes.
+         *
+         * @returns \c this
+         */
+        inline fec_istream* setbuf(char* buf, size_t capacity,
+            char* scratch) {
+            _ibuf.setbuf(buf, capacity);
+            _scratch = scratch;
+            return this;
+        }
+
+        virtual istream& sync() {
+            if (_ibuf._error._flags.uninitialized) {
+                return *this;
+            }
+            _ibuf.compact();
+            _link.ibuf().compact(); // make room for the rest of the block
+            _link.sync();
+            const size_t stride = _code.stride();
+            const size_t width = _code.width();
+            const size_t cap = _code.k() * width - 2;
+            streambuf& sb = _link.ibuf();
+            while (sb.in_avail() >= _code.size()
+                && (size_t) (_ibuf.epptr() - _ibuf.pptr()) >= cap) {
+                char* b = sb.gptr();
+                int r = _code.decode(b, _scratch);
+                size_t len = (unsigned char) b[0]
+                    | (size_t) (unsigned char) b[1] << 8;
+                if (r < 0 || len > cap) {
+                    ++_errors;
+                    _ierror._flags.corrupt = true;
+                    sb.gbump(_code.size());
+                    continue;
+                }
+                _repaired += r > 0;
+
+                char* p = _ibuf.pptr();
+                size_t left = len;
+                for (size_t i = 0; left; ++i) {
+                    size_t c = min(width - (i ? 0 : 2), left);
+                    memcpy(p, b + i * stride + (i ? 0 : 2), c);
+                    p += c;
+                    left -= c;
+                }
+                _ibuf.pbump(len);
+                sb.gbump(_code.size());
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Get the number of blocks that could not be repaired.
+         *
+         * @returns The number of dropped blocks.
+         */
+        inline uint32_t errors() const {
+            return _errors;
+        }
+
+        /**
+         * @brief Get the number of blocks that were repaired.
+         *
+         * @returns The number of blocks that had rows fail their CRC.
+         */
+        inline uint32_t repaired() const {
+            return _repaired;
+        }
+
+    private:
+        istream& _link;
+        fec_code _code;
+        char* _scratch;
+        uint32_t _errors;
+        uint32_t _repaired;
+    };
+};
+
+#endif // UIO_FEC_H
@@ -0,0 +1,401 @@
+#ifndef UIO_HDLC_H
+#define UIO_HDLC_H
+/**
+ * @file
+ * @brief HDLC-like framing (RFC 1662 byte stuffing).
+ *
+ * \par
+ * Each frame is sent as a flag byte (0x7E), the stuffed payload and frame
+ * check sequence (FCS), and another flag byte. Flag and escape (0x7D) bytes
+ * in the payload or FCS are sent as an escape byte followed by the byte
+ * XOR 0x20. The FCS is CRC-16/X-25 or CRC-32, sent least significant byte
+ * first.
+ *
+ * \par
+ * Runs of bytes that do not need escaping are found a machine word at a
+ * time and copied with \c memcpy, so framing costs little more than a
+ * copy. A \ref uio::hdlc_ostream stuffs straight into the link's output
+ * buffer, and a \ref uio::hdlc_deframer unstuffs in place in the link's
+ * input buffer and hands out frames without copying them.
+ */
+#include <stdint.h>
+#include "uio.hpp"
+#include "uio_crc.hpp"
+
+namespace uio {
+
+    /**
+     * @brief The frame check sequences.
+     *
+     * The value of each is its size in bytes.
+     */
+    enum hdlc_fcs {
+        HDLC_FCS16 = 2, ///< CRC-16/X-25.
+        HDLC_FCS32 = 4  ///< CRC-32.
+    };
+
+    /// \cond DO_NOT_DOCUMENT
+    enum {
+        HDLC_FLAG = 0x7E,
+        HDLC_ESCAPE = 0x7D,
+        HDLC_XOR = 0x20
+    };
+
+    // the FCS over a frame, including its own FCS, is this constant
+    inline uint32_t hdlc_good(hdlc_fcs fcs) {
+        return fcs == HDLC_FCS16 ? 0x0F47 : 0x2144DF1C;
+    }
+
+    inline uint32_t hdlc_crc(hdlc_fcs fcs, const char* s, size_t n,
+        uint32_t crc) {
+        return fcs == HDLC_FCS16 ? crc16_x25(s, n, (uint16_t) crc)
+            : crc32(s, n, crc);
+    }
+
+    // index of the first flag or escape byte in [s, s + n), or n
+    inline size_t hdlc_scan(const char* s, size_t n) {
+        const size_t ones = (size_t) -1 / 0xFF;
+        size_t i = 0;
+        for (; i + sizeof(size_t) <= n; i += sizeof(size_t)) {
+            size_t w;
+            memcpy(&w, s + i, sizeof(w));
+            size_t f = w ^ (ones * HDLC_FLAG);
+            size_t e = w ^ (ones * HDLC_ESCAPE);
+            if ((((f - ones) & ~f) | ((e - ones) & ~e)) & (ones << 7)) {
+                break;
+            }
+        }
+        for (; i < n; ++i) {
+            if (s[i] == (char) HDLC_FLAG || s[i] == (char) HDLC_ESCAPE) {
+                break;
+            }
+        }
+        return i;
+    }
+    /// \endcond
+
+    /**
+     * @brief A sender of HDLC frames on a link.
+     *
+     * A frame is sent with \ref begin, any number of \ref append calls
+     * (e.g. a header and then a payload that lives elsewhere), and
+     * \ref end. Bytes are stuffed straight into the link's output buffer,
+     * which is flushed whenever it fills up.
+     */
+    class hdlc_framer {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to send frames on.
+         * @param[in] fcs The frame check sequence.
+         */
+        explicit hdlc_framer(ostream& link, hdlc_fcs fcs = HDLC_FCS16)
+            : _link(link), _fcs(fcs) {
+            _crc = 0;
+        }
+
+        /**
+         * @brief Start a frame.
+         *
+         * @returns \c false if the link stopped taking bytes.
+         */
+        bool begin() {
+            const char flag = HDLC_FLAG;
+            _crc = 0;
+            return put_raw(&flag, 1);
+        }
+
+        /**
+         * @brief Append bytes to the frame.
+         *
+         * @param[in] s The first byte.
+         * @param[in] n The number of bytes.
+         *
+         * @returns \c false if the link stopped taking bytes.
+         */
+        bool append(const char* s, size_t n) {
+            while (n) {
+                size_t k = hdlc_scan(s, n);
+                _crc = hdlc_crc(_fcs, s, k + (k < n), _crc);
+                if (!put_raw(s, k)) {
+                    return false;
+                }
+                s += k;
+                n -= k;
+                if (n) {
+                    char esc[2] = { (char) HDLC_ESCAPE, (char) (*s ^ HDLC_XOR) };
+                    if (!put_raw(esc, 2)) {
+                        return false;
+                    }
+                    ++s;
+                    --n;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief End the frame with its FCS and a flag.
+         *
+         * @returns \c false if the link stopped taking bytes.
+         */
+        bool end() {
+            const char flag = HDLC_FLAG;
+            char fcs[4];
+            uint32_t crc = _crc;
+            for (size_t i = 0; i < (size_t) _fcs; ++i) {
+                fcs[i] = (char) (crc >> (8 * i));
+            }
+            return append(fcs, _fcs) && put_raw(&flag, 1);
+        }
+
+    private:
+        // copy to the link, flushing it when its buffer is full
+        bool put_raw(const char* s, size_t n) {
+            streambuf& sb = _link.obuf();
+            while (n) {
+                char* p = sb.pptr();
+                if (p == sb.epptr()) {
+                    _link.flush();
+                    p = sb.pptr();
+                    if (p == sb.epptr()) {
+                        return false;
+                    }
+                }
+                size_t k = min((size_t) (sb.epptr() - p), n);
+                memcpy(p, s, k);
+                sb.pbump(k);
+                s += k;
+                n -= k;
+            }
+            return true;
+        }
+
+        ostream& _link;
+        hdlc_fcs _fcs;
+        uint32_t _crc;
+    };
+
+    /**
+     * @brief An output stream that sends HDLC frames over a link.
+     *
+     * Bytes written to the stream are buffered, and \ref flush sends them
+     * as one frame and flushes the link.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class hdlc_ostream : public ostream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to send frames on.
+         * @param[in] fcs The frame check sequence.
+         */
+        explicit hdlc_ostream(ostream& link, hdlc_fcs fcs = HDLC_FCS16)
+            : _link(link), _framer(link, fcs) {}
+
+        /**
+         * @brief Initialize the frame buffer.
+         *
+         * @param buf Memory allocation for the frame buffer.
+         * @param capacity Size of the buffer (i.e. the largest payload).
+         *
+         * @returns \c this
+         */
+        inline hdlc_ostream* setbuf(char* buf, size_t capacity) {
+            _obuf.setbuf(buf, capacity);
+            return this;
+        }
+
+        /**
+         * @brief Send the buffered bytes as one frame.
+         *
+         * The link is flushed whenever its output buffer fills up.
+         *
+         * @note \c _oerror._flags.overflow is set, and the payload is kept
+         * for a retry, if the link stops taking bytes. The receiver drops
+         * the partial frame.
+         *
+         * @returns \c *this
+         */
+        virtual ostream& flush() {
+            size_t n = _obuf.in_avail();
+            if (!n) {
+                return *this;
+            }
+            if (!_framer.begin() || !_framer.append(_obuf.gptr(), n)
+                || !_framer.end()) {
+                _oerror._flags.overflow = true;
+                return *this;
+            }
+            _obuf.gbump(n);
+            _link.flush();
+            return *this;
+        }
+
+    private:
+        ostream& _link;
+        hdlc_framer _framer;
+    };
+
+    /**
+     * @brief A receiver of HDLC frames from a link.
+     *
+     * Frames are unstuffed in place in the link's input buffer, so the
+     * largest frame (stuffed, plus its closing flag) must fit in that
+     * buffer.
+     *
+     * Frames whose FCS is wrong are dropped and set the link's
+     * \c _ierror._flags.corrupt. Frames that do not fit in the input buffer
+     * are dropped and set the link's \c _ierror._flags.overflow.
+     */
+    class hdlc_deframer {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to receive frames from.
+         * @param[in] fcs The frame check sequence.
+         */
+        explicit hdlc_deframer(istream& link, hdlc_fcs fcs = HDLC_FCS16)
+            : _link(link), _fcs(fcs) {
+            _hunt = true;
+            _scan = 0;
+            _out = 0;
+            _crc = 0;
+            _frame = 0;
+            _errors = 0;
+        }
+
+        /**
+         * @brief Get the next frame.
+         *
+         * The previous frame is released first. The link is synced (at most
+         * once) if the buffered input does not hold a complete frame.
+         *
+         * @param[out] frame The frame's payload, in the link's input buffer.
+         * It stays valid until the frame is released.
+         * @param[out] len The length of the payload.
+         *
+         * @returns \c true if a frame was received.
+         */
+        bool next(const char** frame, size_t* len) {
+            release();
+            streambuf& sb = _link.ibuf();
+            for (bool synced = false; ; synced = true) {
+                if (_hunt) {
+                    const char* f = (const char*) memchr(sb.gptr(), HDLC_FLAG,
+                        sb.in_avail());
+                    sb.gbump(f ? f - sb.gptr() + 1 : sb.in_avail());
+                    _hunt = !f;
+                }
+                if (!_hunt && unstuff(frame, len)) {
+                    return true;
+                }
+                if (synced) {
+                    return false;
+                }
+
+                // make room at the back for the rest of the frame
+                sb.compact();
+                if (sb.in_avail() && sb.pptr() == sb.epptr()) {
+                    ++_errors;
+                    _link._ierror._flags.overflow = true;
+                    sb.gbump(sb.in_avail());
+                    restart();
+                    _hunt = true;
+                }
+                _link.sync();
+            }
+        }
+
+        /**
+         * @brief Release the last frame's space in the link's input buffer.
+         */
+        void release() {
+            if (_frame) {
+                // the closing flag can open the next frame
+                _link.ibuf().gbump(_frame);
+                restart();
+            }
+        }
+
+        /**
+         * @brief Get the number of frames that have been dropped.
+         *
+         * @returns The number of corrupt and oversized frames.
+         */
+        inline uint32_t errors() const {
+            return _errors;
+        }
+
+    private:
+        void restart() {
+            _scan = 0;
+            _out = 0;
+            _crc = 0;
+            _frame = 0;
+        }
+
+        // unstuff the buffered input; true at the end of a good frame
+        bool unstuff(const char** frame, size_t* len) {
+            streambuf& sb = _link.ibuf();
+            char* base = sb.gptr();
+            size_t avail = sb.in_avail();
+            while (_scan < avail) {
+                size_t k = hdlc_scan(base + _scan, avail - _scan);
+                if (_out != _scan) {
+                    memmove(base + _out, base + _scan, k);
+                }
+                _crc = hdlc_crc(_fcs, base + _out, k, _crc);
+                _out += k;
+                _scan += k;
+                if (_scan == avail) {
+                    break;
+                }
+
+                if (base[_scan] == (char) HDLC_ESCAPE) {
+                    if (_scan + 1 == avail) {
+                        break; // wait for the escaped byte
+                    }
+                    base[_out] = (char) (base[_scan + 1] ^ HDLC_XOR);
+                    _crc = hdlc_crc(_fcs, base + _out, 1, _crc);
+                    ++_out;
+                    _scan += 2;
+                    continue;
+                }
+
+                // closing flag
+                if (_out >= (size_t) _fcs && _crc == hdlc_good(_fcs)) {
+                    *frame = base;
+                    *len = _out - _fcs;
+                    _frame = _scan;
+                    return true;
+                }
+                if (_out) {
+                    ++_errors;
+                    _link._ierror._flags.corrupt = true;
+                }
+                sb.gbump(_scan + 1);
+                base = sb.gptr();
+                avail = sb.in_avail();
+                restart();
+            }
+            return false;
+        }
+
+        istream& _link;
+        hdlc_fcs _fcs;
+        bool _hunt;
+        size_t _scan;
+        size_t _out;
+        uint32_t _crc;
+        size_t _frame;
+        uint32_t _errors;
+    };
+};
+
+#endif // UIO_HDLC_H
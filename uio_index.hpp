@@ -0,0 +1,384 @@
+#ifndef UIO_INDEX_H
+#define UIO_INDEX_H
+/**
+ * @file
+ * @brief Record-indexed streams for random access into captures.
+ *
+ * \par
+ * An \ref uio::indexed_ostream writes records to a data file and, on the
+ * side, two index files: the data offset of each record (8 bytes per
+ * record) and the number of the first record in each time bucket (4 bytes
+ * per bucket). Because index entries have a fixed size, an
+ * \ref uio::indexed_istream can find any record, or the first record at or
+ * after any time, with a single index read.
+ */
+#include <stdint.h>
+#include "uio.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+namespace uio {
+
+    /**
+     * @brief The files that make up an indexed capture.
+     */
+    enum index_file {
+        DATA_FILE,      ///< The records' data.
+        RECORD_INDEX,   ///< The data offset of each record.
+        TIME_INDEX      ///< The first record of each time bucket.
+    };
+
+    /**
+     * @brief An output stream that writes indexed records.
+     *
+     * Bytes written to the stream are buffered, and \ref flush writes them
+     * as one record, stamped with the time given to \ref stamp. Record
+     * times must not decrease. Derived classes implement \ref write_at for
+     * the storage device.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class indexed_ostream : public ostream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] t0 Start time of the first time bucket.
+         * @param[in] width Length of each time bucket.
+         */
+        indexed_ostream(uint32_t t0, uint32_t width) {
+            _t0 = t0;
+            _width = width ? width : 1;
+            _time = t0;
+            _offset = 0;
+            _start = 0;
+            _unindexed = false;
+            _records = 0;
+            _buckets = 0;
+        }
+
+        /**
+         * @brief Initialize the record buffer.
+         *
+         * @param buf Memory allocation for the record buffer.
+         * @param capacity Size of the buffer (i.e. the largest record).
+         *
+         * @returns \c this
+         */
+        inline indexed_ostream* setbuf(char* buf, size_t capacity) {
+            _obuf.setbuf(buf, capacity);
+            return this;
+        }
+
+        /**
+         * @brief Set the time of the next record.
+         *
+         * @param[in] t The record's time.
+         */
+        inline void stamp(uint32_t t) {
+            _time = t;
+        }
+
+        /**
+         * @brief Write the buffered bytes as one record.
+         *
+         * @note \c _oerror._flags.overflow is set if the record could not
+         * be written to the files, and it is kept for a retry. If its data
+         * was written but its index entry was not, the entry is written by
+         * the next flush.
+         *
+         * @returns \c *this
+         */
+        virtual ostream& flush() {
+            if (_unindexed && !index()) {
+                _oerror._flags.overflow = true;
+                return *this;
+            }
+            size_t n = _obuf.in_avail();
+            if (!n) {
+                return *this;
+            }
+
+            // fill every bucket up to this record's bucket
+            char entry[8];
+            uint32_t bucket = _time > _t0 ? (_time - _t0) / _width : 0;
+            while (_buckets <= bucket) {
+                encode(entry, _records, 4);
+                if (!write_at(TIME_INDEX, entry, 4, (uint64_t) _buckets * 4)) {
+                    _oerror._flags.overflow = true;
+                    return *this;
+                }
+                ++_buckets;
+            }
+
+            if (!write_at(DATA_FILE, _obuf.gptr(), n, _offset)) {
+                _oerror._flags.overflow = true;
+                return *this;
+            }
+            _obuf.gbump(n);
+            _start = _offset;
+            _offset += n;
+            _unindexed = true;
+            if (!index()) {
+                _oerror._flags.overflow = true;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Get the number of records that have been written.
+         *
+         * @returns The number of the next record.
+         */
+        inline uint32_t records() const {
+            return _records;
+        }
+
+    protected:
+        /**
+         * @brief Pure virtual function to write bytes to one of the
+         * capture's files.
+         *
+         * Each file is written in order, but a write that failed is
+         * retried at the same offset, so a partial write must not be
+         * mistaken for the end of the file.
+         *
+         * @param[in] f The file to write to.
+         * @param[in] s The address of the first byte to be written.
+         * @param[in] n The number of bytes to be written.
+         * @param[in] offset The offset in the file to write at.
+         *
+         * @returns \c true if all \a n bytes were written.
+         */
+        virtual bool write_at(index_file f, const char* s, size_t n,
+            uint64_t offset) = 0;
+
+    private:
+        // write the index entry of the record whose data was written last
+        bool index() {
+            char entry[8];
+            encode(entry, _start, 8);
+            if (!write_at(RECORD_INDEX, entry, 8, (uint64_t) _records * 8)) {
+                return false;
+            }
+            _unindexed = false;
+            ++_records;
+            return true;
+        }
+
+        static void encode(char* s, uint64_t v, size_t n) {
+            for (size_t i = 0; i < n; ++i) {
+                s[i] = (char) (v >> (8 * i));
+            }
+        }
+
+        uint32_t _t0;
+        uint32_t _width;
+        uint32_t _time;
+        uint64_t _offset;
+        uint64_t _start;    // data offset of the last record
+        bool _unindexed;    // the last record has no index entry yet
+        uint32_t _records;
+        uint32_t _buckets;
+    };
+
+    /**
+     * @brief An input stream that reads indexed records.
+     *
+     * \ref sync reads the data file sequentially, and \ref seek_record and
+     * \ref seek_time move the read position to the start of a record.
+     * Derived classes implement \ref read_at for the storage device.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class indexed_istream : public istream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] t0 Start time of the first time bucket.
+         * @param[in] width Length of each time bucket.
+         */
+        indexed_istream(uint32_t t0, uint32_t width) {
+            _t0 = t0;
+            _width = width ? width : 1;
+            _pos = 0;
+        }
+
+        /**
+         * @brief Initialize the input buffer.
+         *
+         * @param buf Memory allocation for the input buffer.
+         * @param capacity Size of the buffer.
+         *
+         * @returns \c this
+         */
+        inline indexed_istream* setbuf(char* buf, size_t capacity) {
+            _ibuf.setbuf(buf, capacity);
+            return this;
+        }
+
+        /**
+         * @brief Read the next part of the data file into the input buffer.
+         *
+         * @returns \c *this
+         */
+        virtual istream& sync() {
+            _ibuf.compact();
+            char* p = _ibuf.pptr();
+            size_t n = read_at(DATA_FILE, p, _ibuf.epptr() - p, _pos);
+            _ibuf.pbump(n);
+            _pos += n;
+            return *this;
+        }
+
+        /**
+         * @brief Move the read position to the start of record \a n.
+         *
+         * Buffered input data is discarded, and the input buffer is
+         * refilled from the record's offset.
+         *
+         * @param[in] n The record's number.
+         *
+         * @returns \c true if record \a n exists.
+         */
+        bool seek_record(uint32_t n) {
+            char entry[8];
+            if (read_at(RECORD_INDEX, entry, 8, (uint64_t) n * 8) != 8) {
+                return false;
+            }
+            _pos = decode(entry, 8);
+            _ibuf.purge();
+            sync();
+            return true;
+        }
+
+        /**
+         * @brief Move the read position to the first record whose time is
+         * in \a t's time bucket or later.
+         *
+         * @param[in] t The time to seek to.
+         *
+         * @returns \c true if such a record exists.
+         */
+        bool seek_time(uint32_t t) {
+            char entry[4];
+            uint32_t bucket = t > _t0 ? (t - _t0) / _width : 0;
+            if (read_at(TIME_INDEX, entry, 4, (uint64_t) bucket * 4) != 4) {
+                return false;
+            }
+            return seek_record((uint32_t) decode(entry, 4));
+        }
+
+    protected:
+        /**
+         * @brief Pure virtual function to read bytes from one of the
+         * capture's files.
+         *
+         * @param[in] f The file to read from.
+         * @param[out] s The address to copy the bytes to.
+         * @param[in] n The maximum number of bytes to read.
+         * @param[in] offset The offset in the file to read from.
+         *
+         * @returns The number of bytes that were read.
+         */
+        virtual size_t read_at(index_file f, char* s, size_t n,
+            uint64_t offset) = 0;
+
+    private:
+        static uint64_t decode(const char* s, size_t n) {
+            uint64_t v = 0;
+            for (size_t i = 0; i < n; ++i) {
+                v |= (uint64_t) (unsigned char) s[i] << (8 * i);
+            }
+            return v;
+        }
+
+        uint32_t _t0;
+        uint32_t _width;
+        uint64_t _pos;
+    };
+
+#if defined(__unix__) || defined(__APPLE__)
+    /**
+     * @brief An \ref indexed_ostream that writes three open files.
+     *
+     * The files are written from offset 0 with \c pwrite.
+     */
+    class file_indexed_ostream : public indexed_ostream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] fds File descriptors of the data file, the record
+         * index and the time index, in \ref index_file order.
+         * @param[in] t0 Start time of the first time bucket.
+         * @param[in] width Length of each time bucket.
+         */
+        file_indexed_ostream(const int fds[3], uint32_t t0, uint32_t width)
+            : indexed_ostream(t0, width) {
+            memcpy(_fds, fds, sizeof(_fds));
+        }
+
+    protected:
+        virtual bool write_at(index_file f, const char* s, size_t n,
+            uint64_t offset) {
+            while (n) {
+                ssize_t w = pwrite(_fds[f], s, n, (off_t) offset);
+                if (w <= 0) {
+                    return false;
+                }
+                s += w;
+                n -= w;
+                offset += w;
+            }
+            return true;
+        }
+
+    private:
+        int _fds[3];
+    };
+
+    /**
+     * @brief An \ref indexed_istream that reads three open files.
+     */
+    class file_indexed_istream : public indexed_istream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] fds File descriptors of the data file, the record
+         * index and the time index, in \ref index_file order.
+         * @param[in] t0 Start time of the first time bucket.
+         * @param[in] width Length of each time bucket.
+         */
+        file_indexed_istream(const int fds[3], uint32_t t0, uint32_t width)
+            : indexed_istream(t0, width) {
+            memcpy(_fds, fds, sizeof(_fds));
+        }
+
+    protected:
+        virtual size_t read_at(index_file f, char* s, size_t n,
+            uint64_t offset) {
+            size_t m = 0;
+            while (m < n) {
+                ssize_t r = pread(_fds[f], s + m, n - m, (off_t) (offset + m));
+                if (r <= 0) {
+                    break;
+                }
+                m += r;
+            }
+            return m;
+        }
+
+    private:
+        int _fds[3];
+    };
+#endif
+};
+
+#endif // UIO_INDEX_H
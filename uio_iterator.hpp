@@ -0,0 +1,311 @@
+#ifndef UIO_ITERATOR_H
+#define UIO_ITERATOR_H
+/**
+ * @file
+ * @brief Iterator and range adapters over input streams.
+ *
+ * \par
+ * \ref uio::segment views the readable region of an input stream's buffer
+ * as a contiguous range of bytes, so any algorithm (including C++20 ranges
+ * algorithms) runs over it with plain pointers. \ref uio::istream_iterator
+ * reads a stream byte by byte and refills it through \ref uio::istream::sync
+ * when the buffer runs dry, so algorithms can also consume input that
+ * arrives over several syncs.
+ *
+ * \par
+ * \ref uio::copy and \ref uio::find are overloads for
+ * \ref uio::istream_iterator that work one buffered segment at a time (with
+ * \c memcpy and \c memchr) instead of one byte at a time. They are found by
+ * argument-dependent lookup, so an unqualified call picks them up:
+ *
+ * \code
+ * using std::copy;
+ * copy(uio::istream_iterator(uart), uio::istream_iterator(), dst);
+ * \endcode
+ */
+#include <stddef.h>
+#include <algorithm>
+#include <iterator>
+#include "uio.hpp"
+
+#if __cplusplus >= 202002L
+#include <ranges>
+#endif
+
+namespace uio {
+
+    /**
+     * @brief A view of the bytes that are buffered in an input stream.
+     *
+     * The view is invalidated by anything that changes the stream's input
+     * buffer (e.g. \ref istream::get or \ref istream::sync).
+     */
+    class input_segment {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] first First byte of the segment.
+         * @param[in] last One past the last byte of the segment.
+         */
+        input_segment(const char* first, const char* last)
+            : _first(first), _last(last) {}
+
+        inline const char* begin() const {
+            return _first;
+        }
+
+        inline const char* end() const {
+            return _last;
+        }
+
+        inline const char* data() const {
+            return _first;
+        }
+
+        inline size_t size() const {
+            return _last - _first;
+        }
+
+        inline bool empty() const {
+            return _first == _last;
+        }
+
+    private:
+        const char* _first;
+        const char* _last;
+    };
+
+    /**
+     * @brief Get a view of the bytes that are buffered in an input stream.
+     *
+     * The bytes are not consumed; use \c is.ibuf().gbump(n) once they have
+     * been processed.
+     *
+     * @param[in] is Input stream.
+     *
+     * @returns The readable region of \c is.ibuf().
+     */
+    inline input_segment segment(istream& is) {
+        streambuf& sb = is.ibuf();
+        return input_segment(sb.gptr(), sb.egptr());
+    }
+
+    /**
+     * @brief An input iterator that reads the bytes of an input stream.
+     *
+     * When the input buffer is empty, the iterator calls
+     * \ref istream::sync; it becomes equal to the end iterator (the
+     * default-constructed iterator) once a sync produces no input. Like
+     * \c std::istreambuf_iterator, all iterators on the same stream share
+     * its read position.
+     */
+    class istream_iterator {
+    public:
+        typedef std::input_iterator_tag iterator_category;
+        typedef char value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const char* pointer;
+        typedef const char& reference;
+
+        /**
+         * @brief The result of a postfix increment, which holds the byte
+         * that was read.
+         */
+        class proxy {
+        public:
+            explicit proxy(char c) : _c(c) {}
+
+            inline char operator*() const {
+                return _c;
+            }
+
+        private:
+            char _c;
+        };
+
+        /**
+         * @brief Construct the end iterator.
+         */
+        istream_iterator() : _is(NULL) {}
+
+        /**
+         * @brief Construct an iterator at the read position of \a is.
+         *
+         * @param[in] is Input stream.
+         */
+        explicit istream_iterator(istream& is) : _is(&is) {}
+
+        inline reference operator*() const {
+            fill();
+            return *_is->ibuf().gptr();
+        }
+
+        inline istream_iterator& operator++() {
+            if (fill()) {
+                _is->ibuf().gbump(1);
+            }
+            return *this;
+        }
+
+        inline proxy operator++(int) {
+            proxy p(**this);
+            ++*this;
+            return p;
+        }
+
+        /**
+         * @brief Compare iterators.
+         *
+         * @returns \c true if both iterators are at the end of input, or
+         * both read the same stream.
+         */
+        inline bool operator==(const istream_iterator& other) const {
+            return !fill() == !other.fill();
+        }
+
+        inline bool operator!=(const istream_iterator& other) const {
+            return !(*this == other);
+        }
+
+        /**
+         * @brief Get the stream that the iterator reads.
+         *
+         * @returns The stream, or \c NULL for the end iterator.
+         */
+        inline istream* stream() const {
+            return _is;
+        }
+
+        /**
+         * @brief Make sure that input is buffered.
+         *
+         * @returns \c true if there is at least one byte to read.
+         */
+        bool fill() const {
+            return _is && (_is->ibuf().in_avail()
+                || _is->sync().ibuf().in_avail());
+        }
+
+    private:
+        istream* _is;
+    };
+
+    /**
+     * @brief A range over the bytes of an input stream.
+     *
+     * This lets range-based \c for loops and C++20 ranges algorithms read
+     * a stream through \ref istream_iterator.
+     */
+    class input_range {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] is Input stream.
+         */
+        explicit input_range(istream& is) : _is(&is) {}
+
+        inline istream_iterator begin() const {
+            return istream_iterator(*_is);
+        }
+
+        inline istream_iterator end() const {
+            return istream_iterator();
+        }
+
+    private:
+        istream* _is;
+    };
+
+    /**
+     * @brief Copy the bytes in [\a first, \a last) to \a out, one buffered
+     * segment at a time.
+     *
+     * @param[in] first Iterator to read from.
+     * @param[in] last End iterator.
+     * @param[out] out Address to begin copying to.
+     *
+     * @returns One past the last byte copied.
+     */
+    inline char* copy(istream_iterator first, istream_iterator last,
+        char* out) {
+        while (first != last) {
+            streambuf& sb = first.stream()->ibuf();
+            size_t n = sb.in_avail();
+            memcpy(out, sb.gptr(), n);
+            sb.gbump(n);
+            out += n;
+        }
+        return out;
+    }
+
+    /**
+     * @brief Copy the bytes in [\a first, \a last) to \a out, one buffered
+     * segment at a time.
+     *
+     * @param[in] first Iterator to read from.
+     * @param[in] last End iterator.
+     * @param[out] out Output iterator.
+     *
+     * @returns \a out after the last byte copied.
+     */
+    template<class OutputIt>
+    OutputIt copy(istream_iterator first, istream_iterator last,
+        OutputIt out) {
+        while (first != last) {
+            streambuf& sb = first.stream()->ibuf();
+            size_t n = sb.in_avail();
+            out = std::copy((const char*) sb.gptr(),
+                (const char*) sb.egptr(), out);
+            sb.gbump(n);
+        }
+        return out;
+    }
+
+    /**
+     * @brief Find the first byte in [\a first, \a last) that is equal to
+     * \a value, searching one buffered segment at a time.
+     *
+     * The bytes before the match are consumed.
+     *
+     * @param[in] first Iterator to read from.
+     * @param[in] last End iterator.
+     * @param[in] value Value to search for.
+     *
+     * @returns An iterator at the match, or one equal to \a last.
+     */
+    template<class T>
+    istream_iterator find(istream_iterator first, istream_iterator last,
+        const T& value) {
+        char c = (char) value;
+        bool match = (c == value);
+        while (first != last) {
+            streambuf& sb = first.stream()->ibuf();
+            size_t n = sb.in_avail();
+            const char* p = match
+                ? (const char*) memchr(sb.gptr(), (unsigned char) c, n)
+                : NULL;
+            if (p) {
+                sb.gbump(p - sb.gptr());
+                break;
+            }
+            sb.gbump(n);
+        }
+        return first;
+    }
+};
+
+#if __cplusplus >= 202002L
+/// \cond DO_NOT_DOCUMENT
+// the views do not own the bytes, so iterators outlive them
+template<>
+inline constexpr bool std::ranges::enable_borrowed_range<uio::input_segment>
+    = true;
+template<>
+inline constexpr bool std::ranges::enable_borrowed_range<uio::input_range>
+    = true;
+/// \endcond
+#endif
+
+#endif // UIO_ITERATOR_H
@@ -0,0 +1,359 @@
+#ifndef UIO_JOURNAL_H
+#define UIO_JOURNAL_H
+/**
+ * @file
+ * @brief Group-commit journaling output streams.
+ *
+ * \par
+ * Many \ref uio::journal_ostream producers share one \ref uio::journal.
+ * Flushing a producer only queues its buffered data; \ref uio::journal::commit
+ * then makes every queued producer's data durable with one vectored write
+ * and one storage sync, so the cost of a sync is shared by the whole batch.
+ */
+#include <stdint.h>
+#include "uio.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#ifndef UIO_JOURNAL_BATCH
+/**
+ * @brief Maximum number of queued segments in a \ref uio::journal batch.
+ */
+#define UIO_JOURNAL_BATCH 32
+#endif
+
+namespace uio {
+
+    class journal_ostream;
+
+    /**
+     * @brief A journal that commits its producers' data in groups.
+     *
+     * Derived classes implement \ref write_batch and \ref sync_batch for the
+     * storage device.
+     *
+     * @note This class is not thread-safe. Producers and \ref commit must be
+     * called from the same thread (e.g. an event loop).
+     */
+    class journal {
+    public:
+        /**
+         * @brief A queued run of bytes from a producer's output buffer.
+         */
+        struct segment {
+            const char* data;           ///< First byte of the segment.
+            size_t len;                 ///< Number of bytes in the segment.
+            journal_ostream* producer;  ///< Producer that owns the bytes.
+        };
+
+        /**
+         * @brief Default constructor.
+         */
+        journal() {
+            _count = 0;
+            _offset = 0;
+            _queued = 0;
+            _durable = 0;
+        }
+
+        virtual ~journal() {}
+
+        /**
+         * @brief Make every queued segment durable.
+         *
+         * The batch is written with one call to \ref write_batch followed by
+         * one call to \ref sync_batch. Then each producer in the batch is
+         * released and notified through \ref journal_ostream::committed.
+         *
+         * @returns The number of bytes that were committed, or 0 if the
+         * batch could not be written (the batch is kept for a retry).
+         */
+        size_t commit();
+
+        /**
+         * @brief Get the number of batches that have been committed.
+         *
+         * @returns The sequence number of the last durable batch.
+         */
+        inline uint32_t durable() const {
+            return _durable;
+        }
+
+        /**
+         * @brief Get the number of bytes waiting to be committed.
+         *
+         * @returns The total length of the queued segments.
+         */
+        inline size_t queued() const {
+            return _queued;
+        }
+
+        /**
+         * @brief Get the journal's size.
+         *
+         * @returns The offset that the next batch will be written at.
+         */
+        inline uint64_t offset() const {
+            return _offset;
+        }
+
+    protected:
+        /**
+         * @brief Pure virtual function to write a batch to the storage
+         * device.
+         *
+         * @param[in] segs The segments to be written, in order.
+         * @param[in] n The number of segments.
+         * @param[in] offset Offset to write the first segment at.
+         *
+         * @returns \c true if every segment was written.
+         */
+        virtual bool write_batch(const segment* segs, size_t n,
+            uint64_t offset) = 0;
+
+        /**
+         * @brief Pure virtual function to make written batches durable
+         * (e.g. \c fdatasync).
+         *
+         * @returns \c true if the written data is durable.
+         */
+        virtual bool sync_batch() = 0;
+
+    private:
+        friend class journal_ostream;
+
+        bool queue(journal_ostream* producer, const char* s, size_t n);
+
+        segment _segs[UIO_JOURNAL_BATCH];
+        size_t _count;
+        uint64_t _offset;
+        size_t _queued;
+        uint32_t _durable;
+    };
+
+    /**
+     * @brief An output stream that writes to a \ref journal.
+     *
+     * \ref flush queues the buffered data in the journal without copying
+     * it. The output buffer's space is released once the journal has
+     * committed the data.
+     *
+     * @attention \ref attach \em must be called before
+     * this class can be used.
+     */
+    class journal_ostream : public ostream {
+    public:
+        /**
+         * @brief Default constructor.
+         */
+        journal_ostream() {
+            _journal = NULL;
+            _flushed = 0;
+            _ticket = 0;
+            _oerror._flags.uninitialized = true;
+        }
+
+        /**
+         * @brief Attach the stream to a journal.
+         *
+         * @param[in] j The journal to write to.
+         * @param[in] buf Memory allocation for the output buffer.
+         * @param[in] capacity Size of the output buffer.
+         *
+         * @returns \c this
+         */
+        journal_ostream* attach(journal* j, char* buf, size_t capacity) {
+            _journal = j;
+            _obuf.setbuf(buf, capacity);
+            _flushed = 0;
+            _ticket = 0;
+            _oerror._flags.uninitialized = (j == NULL)
+                || _obuf._error._flags.uninitialized;
+            return this;
+        }
+
+        /**
+         * @brief Queue the buffered data in the journal.
+         *
+         * If the journal's batch is full, it is committed first.
+         *
+         * @note \c _oerror._flags.overflow is set, and the data is kept for
+         * a retry, if the batch is full and could not be committed. The
+         * \ref ticket does not cover the data until it has been queued.
+         *
+         * @returns \c *this
+         */
+        virtual ostream& flush() {
+            if (_oerror._flags.uninitialized) {
+                return *this;
+            }
+            size_t n = _obuf.in_avail() - _flushed;
+            if (!n) {
+                return *this;
+            }
+            if (!_journal->queue(this, _obuf.gptr() + _flushed, n)) {
+                _oerror._flags.overflow = true;
+                return *this;
+            }
+            _flushed += n;
+            _ticket = _journal->durable() + 1;
+            return *this;
+        }
+
+        /**
+         * @brief Check whether all flushed data is durable.
+         *
+         * @returns \c true if the journal has committed everything that was
+         * flushed.
+         */
+        inline bool durable() const {
+            return !_flushed;
+        }
+
+        /**
+         * @brief Get the batch that the last flushed data belongs to.
+         *
+         * The data is durable once \ref journal::durable reaches this
+         * number.
+         *
+         * @returns The sequence number of the batch.
+         */
+        inline uint32_t ticket() const {
+            return _ticket;
+        }
+
+    protected:
+        /**
+         * @brief Called when flushed data has been committed by the
+         * journal.
+         *
+         * @param[in] n The number of bytes that are now durable.
+         */
+        virtual void committed(size_t n) {
+            (void) n;
+        }
+
+    private:
+        friend class journal;
+
+        void release(size_t n) {
+            _obuf.gbump(n);
+            _flushed -= n;
+            if (!_flushed) {
+                _obuf.compact(); // no segment points into the buffer now
+            }
+            committed(n);
+        }
+
+        journal* _journal;
+        size_t _flushed;
+        uint32_t _ticket;
+    };
+
+    /// \cond DO_NOT_DOCUMENT
+    inline bool journal::queue(journal_ostream* producer, const char* s,
+        size_t n) {
+        segment* last = _count ? &_segs[_count - 1] : NULL;
+        if (last && last->producer == producer && last->data + last->len == s) {
+            last->len += n;
+        } else {
+            if (_count == UIO_JOURNAL_BATCH && !commit()) {
+                return false;
+            }
+            _segs[_count].data = s;
+            _segs[_count].len = n;
+            _segs[_count].producer = producer;
+            ++_count;
+        }
+        _queued += n;
+        return true;
+    }
+
+    inline size_t journal::commit() {
+        if (!_count) {
+            return 0;
+        }
+        if (!write_batch(_segs, _count, _offset) || !sync_batch()) {
+            return 0;
+        }
+
+        size_t n = _queued;
+        size_t count = _count;
+        _offset += n;
+        _queued = 0;
+        _count = 0;
+        ++_durable;
+        for (size_t i = 0; i < count; ++i) {
+            _segs[i].producer->release(_segs[i].len);
+        }
+        return n;
+    }
+    /// \endcond
+
+#if defined(__unix__) || defined(__APPLE__)
+    /**
+     * @brief A \ref journal that appends to a file.
+     *
+     * Each batch is written with one \c pwritev and made durable with one
+     * \c fdatasync (\c fsync where \c fdatasync is unavailable).
+     */
+    class file_journal : public journal {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] fd File descriptor of the journal file, opened for
+         * writing. The journal is written from offset 0.
+         */
+        explicit file_journal(int fd) : _fd(fd) {}
+
+    protected:
+        virtual bool write_batch(const segment* segs, size_t n,
+            uint64_t offset) {
+            struct iovec iov[UIO_JOURNAL_BATCH];
+            size_t len = 0;
+            for (size_t i = 0; i < n; ++i) {
+                iov[i].iov_base = (void*) segs[i].data;
+                iov[i].iov_len = segs[i].len;
+                len += segs[i].len;
+            }
+
+            // resume after short writes
+            size_t first = 0;
+            while (len) {
+                ssize_t w = pwritev(_fd, iov + first, (int) (n - first),
+                    (off_t) offset);
+                if (w <= 0) {
+                    return false;
+                }
+                offset += w;
+                len -= w;
+                while (first < n && (size_t) w >= iov[first].iov_len) {
+                    w -= iov[first++].iov_len;
+                }
+                if (first < n) {
+                    iov[first].iov_base = (char*) iov[first].iov_base + w;
+                    iov[first].iov_len -= w;
+                }
+            }
+            return true;
+        }
+
+        virtual bool sync_batch() {
+#if defined(__APPLE__)
+            return fsync(_fd) == 0;
+#else
+            return fdatasync(_fd) == 0;
+#endif
+        }
+
+    private:
+        int _fd;
+    };
+#endif
+};
+
+#endif // UIO_JOURNAL_H
@@ -0,0 +1,220 @@
+#ifndef UIO_MESSAGE_H
+#define UIO_MESSAGE_H
+/**
+ * @file
+ * @brief Compile-time message templates.
+ *
+ * \par
+ * A \ref uio::message_template holds the constant bytes of a fixed-size
+ * message. Sending it copies those bytes into the output buffer with one
+ * fixed-size copy, and then only the variable fields (including length and
+ * CRC fields) are patched in place:
+ *
+ * \code
+ * static constexpr auto status = uio::make_template("\x7E\x10\0\0\0\0\0\0");
+ * status.put(uart).be<2, 2>(seq).le<4, 2>(level).crc16<6, 1>();
+ * \endcode
+ *
+ * \par
+ * Field offsets and widths (and the ranges that CRCs cover) are template
+ * arguments, so they are checked against the message size at compile
+ * time.
+ *
+ * @attention This header requires C++11.
+ */
+#if __cplusplus < 201103L
+#error "uio_message.hpp requires C++11"
+#endif
+
+#include <stdint.h>
+#include "uio.hpp"
+#include "uio_crc.hpp"
+
+namespace uio {
+
+    /**
+     * @brief A message that has been put into an output buffer, whose
+     * variable fields can be patched.
+     *
+     * Patching does nothing if the message did not fit in the buffer.
+     *
+     * @tparam N Size of the message.
+     */
+    template<size_t N>
+    class message_patch {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] p The message's first byte, or \c NULL if it was not
+         * put.
+         */
+        explicit message_patch(char* p) : _p(p) {}
+
+        /**
+         * @brief Store \a v little-endian in bytes [\a Off, \a Off + \a W).
+         *
+         * @returns \c *this
+         */
+        template<size_t Off, size_t W>
+        message_patch& le(uint32_t v) {
+            static_assert(W >= 1 && W <= 4 && Off + W <= N,
+                "field does not fit in the message");
+            if (_p) {
+                for (size_t i = 0; i < W; ++i) {
+                    _p[Off + i] = (char) (v >> (8 * i));
+                }
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Store \a v big-endian in bytes [\a Off, \a Off + \a W).
+         *
+         * @returns \c *this
+         */
+        template<size_t Off, size_t W>
+        message_patch& be(uint32_t v) {
+            static_assert(W >= 1 && W <= 4 && Off + W <= N,
+                "field does not fit in the message");
+            if (_p) {
+                for (size_t i = 0; i < W; ++i) {
+                    _p[Off + i] = (char) (v >> (8 * (W - 1 - i)));
+                }
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Copy \a W bytes from \a s to bytes [\a Off, \a Off + \a W).
+         *
+         * @returns \c *this
+         */
+        template<size_t Off, size_t W>
+        message_patch& bytes(const char* s) {
+            static_assert(Off + W <= N, "field does not fit in the message");
+            if (_p) {
+                memcpy(_p + Off, s, W);
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Store the CRC-16/CCITT of bytes [\a From, \a Off)
+         * big-endian in bytes [\a Off, \a Off + 2).
+         *
+         * @attention Patch the fields covered by the CRC first.
+         *
+         * @returns \c *this
+         */
+        template<size_t Off, size_t From = 0>
+        message_patch& crc16() {
+            static_assert(Off + 2 <= N, "field does not fit in the message");
+            static_assert(From <= Off, "the CRC must follow the bytes it covers");
+            if (_p) {
+                be<Off, 2>(crc16_ccitt(_p + From, Off - From));
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Store the CRC-32 of bytes [\a From, \a Off) little-endian
+         * in bytes [\a Off, \a Off + 4).
+         *
+         * @attention Patch the fields covered by the CRC first.
+         *
+         * @returns \c *this
+         */
+        template<size_t Off, size_t From = 0>
+        message_patch& crc32() {
+            static_assert(Off + 4 <= N, "field does not fit in the message");
+            static_assert(From <= Off, "the CRC must follow the bytes it covers");
+            if (_p) {
+                le<Off, 4>(uio::crc32(_p + From, Off - From));
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Check whether the message was put.
+         *
+         * @returns \c true if the message fit in the output buffer.
+         */
+        explicit operator bool() const {
+            return _p != NULL;
+        }
+
+    private:
+        char* _p;
+    };
+
+    /**
+     * @brief The constant bytes of a fixed-size message.
+     *
+     * @tparam N Size of the message.
+     *
+     * @see make_template
+     */
+    template<size_t N>
+    class message_template {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] image The message's constant bytes (a string literal
+         * of \a N bytes plus its null character, which is not sent).
+         */
+        constexpr explicit message_template(const char (&image)[N + 1])
+            : _image(image) {}
+
+        /**
+         * @brief Put the message's constant bytes into the output buffer.
+         *
+         * @note \c _oerror._flags.overflow is set, and nothing is written,
+         * if there is not enough space in the output buffer.
+         *
+         * @param[in] os Output stream.
+         *
+         * @returns A patch to fill in the message's variable fields.
+         */
+        message_patch<N> put(ostream& os) const {
+            streambuf& sb = os.obuf();
+            char* p = sb.pptr();
+            if ((size_t) (sb.epptr() - p) < N) {
+                os._oerror._flags.overflow = true;
+                os._oerror |= sb._error;
+                return message_patch<N>(NULL);
+            }
+            memcpy(p, _image, N);
+            sb.pbump(N);
+            return message_patch<N>(p);
+        }
+
+        /**
+         * @brief Get the size of the message.
+         *
+         * @returns \a N
+         */
+        static constexpr size_t size() {
+            return N;
+        }
+
+    private:
+        const char* _image;
+    };
+
+    /**
+     * @brief Make a \ref message_template from a string literal.
+     *
+     * @param[in] image The message's constant bytes. The literal's null
+     * character is not part of the message.
+     *
+     * @returns The template.
+     */
+    template<size_t N>
+    constexpr message_template<N - 1> make_template(const char (&image)[N]) {
+        return message_template<N - 1>(image);
+    }
+};
+
+#endif // UIO_MESSAGE_H
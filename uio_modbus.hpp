@@ -0,0 +1,385 @@
+#ifndef UIO_MODBUS_H
+#define UIO_MODBUS_H
+/**
+ * @file
+ * @brief Modbus RTU and ASCII master engine.
+ *
+ * \par
+ * A \ref uio::modbus_master sends queued requests on a bus, matches each
+ * response to its request, checks the response's CRC (RTU) or LRC (ASCII),
+ * and hands its PDU (function code and data) to \ref
+ * uio::modbus_master::completed as a view into the bus's input buffer.
+ * Requests are sent back to back: the next one goes out as soon as the
+ * bus has been idle for the inter-frame gap (t3.5), so many slaves can be
+ * polled without fixed delays between transactions. Only one request is
+ * in flight at a time, since a serial bus is half-duplex and a response
+ * carries nothing but the slave's address to match it by.
+ *
+ * \par
+ * Time is supplied by the application, in ticks of any unit, so the engine
+ * needs no timer of its own:
+ *
+ * \code
+ * for (;;) {
+ *     master.poll(millis());
+ * }
+ * \endcode
+ */
+#include <stdint.h>
+#include "uio.hpp"
+#include "uio_crc.hpp"
+
+#ifndef UIO_MODBUS_QUEUE
+/**
+ * @brief Maximum number of queued \ref uio::modbus_request objects.
+ */
+#define UIO_MODBUS_QUEUE 16
+#endif
+
+namespace uio {
+
+    /**
+     * @brief The Modbus serial transmission modes.
+     */
+    enum modbus_mode {
+        MODBUS_RTU,     ///< Binary frames delimited by silence.
+        MODBUS_ASCII    ///< Hex frames delimited by ':' and CR LF.
+    };
+
+    /**
+     * @brief The states of a \ref modbus_request.
+     */
+    enum modbus_status {
+        MODBUS_QUEUED,  ///< Waiting to be sent.
+        MODBUS_SENT,    ///< Waiting for the response.
+        MODBUS_DONE,    ///< Answered (or a broadcast that has been sent).
+        MODBUS_CORRUPT, ///< The response failed its CRC or LRC check.
+        MODBUS_TIMEOUT  ///< No response arrived in time.
+    };
+
+    /**
+     * @brief A request to a slave.
+     *
+     * The request is owned by the application and \em must stay valid
+     * until it is completed.
+     */
+    struct modbus_request {
+        uint8_t slave;          ///< Slave address (0 to broadcast).
+        const char* pdu;        ///< Function code and data.
+        size_t len;             ///< Length of \ref pdu.
+        uint32_t timeout;       ///< Ticks to wait for the response.
+        modbus_status status;   ///< Progress of the request.
+    };
+
+    /// \cond DO_NOT_DOCUMENT
+    // length of a complete RTU response, or 0 if it cannot be told yet
+    inline size_t modbus_rtu_length(const char* s, size_t n) {
+        if (n < 2) {
+            return 0;
+        }
+        unsigned char f = (unsigned char) s[1];
+        if (f & 0x80) {
+            return 5;
+        }
+        switch (f) {
+        case 0x01: case 0x02: case 0x03: case 0x04: case 0x17:
+            return n < 3 ? 0 : 5 + (unsigned char) s[2];
+        case 0x05: case 0x06: case 0x0F: case 0x10:
+            return 8;
+        default:
+            return 0;
+        }
+    }
+
+    inline int modbus_hex(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        return -1;
+    }
+    /// \endcond
+
+    /**
+     * @brief A Modbus master on a serial bus.
+     *
+     * Requests are sent in the order they were queued, and each one waits
+     * for its response (or its timeout) before the next is sent. A valid
+     * frame that does not answer the request in flight, such as a late
+     * response to a request that timed out, is counted by \ref unmatched
+     * and skipped.
+     *
+     * @note This class is not thread-safe. \ref submit and \ref poll must
+     * be called from the same thread.
+     */
+    class modbus_master {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] bus The stream to the bus.
+         * @param[in] mode The transmission mode.
+         * @param[in] t35 The inter-frame gap, in ticks (3.5 character times
+         * in RTU mode).
+         */
+        modbus_master(iostream& bus, modbus_mode mode, uint32_t t35)
+            : _bus(bus), _mode(mode), _t35(t35) {
+            _head = 0;
+            _count = 0;
+            _active = false;
+            _heard = false;
+            _last = 0;
+            _sent = 0;
+            _unmatched = 0;
+        }
+
+        virtual ~modbus_master() {}
+
+        /**
+         * @brief Queue a request.
+         *
+         * @param[in] r The request.
+         *
+         * @returns \c true if the request was queued.
+         */
+        bool submit(modbus_request* r) {
+            if (_count == UIO_MODBUS_QUEUE) {
+                return false;
+            }
+            r->status = MODBUS_QUEUED;
+            _queue[(_head + _count++) % UIO_MODBUS_QUEUE] = r;
+            return true;
+        }
+
+        /**
+         * @brief Receive and send whatever the bus allows.
+         *
+         * Syncs the bus, completes the request in flight if its response
+         * has arrived (or it has timed out), and sends the next request if
+         * the bus is idle.
+         *
+         * @param[in] now The current time, in ticks.
+         */
+        void poll(uint32_t now) {
+            streambuf& sb = _bus.ibuf();
+            size_t avail = sb.in_avail();
+            _bus.sync();
+            if (sb.in_avail() != avail) {
+                _last = now;
+                _heard = true;
+            }
+            bool idle = !_heard || now - _last >= _t35;
+
+            if (_active) {
+                receive(now, idle);
+            } else if (idle) {
+                // drop stray bytes
+                sb.gbump(sb.in_avail());
+            }
+            if (!_active && _count && idle) {
+                send(now);
+            }
+        }
+
+        /**
+         * @brief Get the number of requests that have not completed.
+         *
+         * @returns The number of queued and in-flight requests.
+         */
+        inline size_t pending() const {
+            return _count;
+        }
+
+        /**
+         * @brief Get the number of valid frames that did not answer the
+         * request in flight.
+         *
+         * A growing count points to a slave that answers too late for its
+         * timeout, or to two slaves with the same address.
+         *
+         * @returns The number of frames skipped.
+         */
+        inline uint32_t unmatched() const {
+            return _unmatched;
+        }
+
+    protected:
+        /**
+         * @brief Called when a request completes.
+         *
+         * @param[in] r The request. Its \c status tells how it completed.
+         * @param[in] pdu The response's function code and data, in the
+         * bus's input buffer (valid only during the call), or \c NULL if
+         * there was no response. Exception responses have the function
+         * code's high bit set.
+         * @param[in] len The length of \a pdu.
+         */
+        virtual void completed(modbus_request& r, const char* pdu,
+            size_t len) {
+            (void) r;
+            (void) pdu;
+            (void) len;
+        }
+
+    private:
+        void send(uint32_t now) {
+            modbus_request* r = _queue[_head];
+            size_t n = r->len + 1;
+            size_t need = _mode == MODBUS_RTU ? n + 2 : 2 * (n + 1) + 3;
+            streambuf& ob = _bus.obuf();
+            if ((size_t) (ob.epptr() - ob.pptr()) < need) {
+                _bus.flush();
+                if ((size_t) (ob.epptr() - ob.pptr()) < need) {
+                    _bus._oerror._flags.overflow = true;
+                    _bus._oerror |= ob._error;
+                    return;
+                }
+            }
+
+            char* p = ob.pptr();
+            if (_mode == MODBUS_RTU) {
+                p[0] = (char) r->slave;
+                memcpy(p + 1, r->pdu, r->len);
+                uint16_t crc = crc16_modbus(p, n);
+                p[n] = (char) crc;
+                p[n + 1] = (char) (crc >> 8);
+            } else {
+                static const char digits[] = "0123456789ABCDEF";
+                unsigned char lrc = r->slave;
+                *p++ = ':';
+                *p++ = digits[r->slave >> 4];
+                *p++ = digits[r->slave & 0xF];
+                for (size_t i = 0; i < r->len; ++i) {
+                    unsigned char c = (unsigned char) r->pdu[i];
+                    lrc = (unsigned char) (lrc + c);
+                    *p++ = digits[c >> 4];
+                    *p++ = digits[c & 0xF];
+                }
+                lrc = (unsigned char) -lrc;
+                *p++ = digits[lrc >> 4];
+                *p++ = digits[lrc & 0xF];
+                *p++ = '\r';
+                *p++ = '\n';
+            }
+            ob.pbump(need);
+            _bus.flush();
+            r->status = MODBUS_SENT;
+            _sent = now;
+            _active = true;
+        }
+
+        void receive(uint32_t now, bool idle) {
+            modbus_request* r = _queue[_head];
+            streambuf& sb = _bus.ibuf();
+            if (!r->slave) {
+                // broadcasts are not answered; wait out the turnaround
+                if (now - _sent >= r->timeout) {
+                    finish(MODBUS_DONE, NULL, 0);
+                }
+                return;
+            }
+
+            if (_mode == MODBUS_ASCII) {
+                const char* colon = (const char*) memchr(sb.gptr(), ':',
+                    sb.in_avail());
+                sb.gbump(colon ? colon - sb.gptr() : sb.in_avail());
+            }
+            char* base = sb.gptr();
+            size_t n = sb.in_avail();
+            size_t len = 0;
+            if (_mode == MODBUS_RTU) {
+                size_t want = modbus_rtu_length(base, n);
+                len = want && n >= want ? want : (n && idle ? n : 0);
+            } else {
+                const char* lf = (const char*) memchr(base, '\n', n);
+                len = lf ? lf - base + 1 : 0;
+            }
+
+            if (!len) {
+                if (now - _sent >= r->timeout) {
+                    finish(MODBUS_TIMEOUT, NULL, 0);
+                }
+                return;
+            }
+
+            const char* pdu = NULL;
+            size_t pdu_len = 0;
+            if (!decode(base, len, &pdu_len)) {
+                _bus._ierror._flags.corrupt = true;
+                sb.gbump(len);
+                finish(MODBUS_CORRUPT, NULL, 0);
+                return;
+            }
+            pdu = base + 1;
+            if ((unsigned char) base[0] != r->slave || !pdu_len
+                || (pdu[0] & 0x7F) != r->pdu[0]) {
+                // not the answer to this request
+                ++_unmatched;
+                sb.gbump(len);
+                return;
+            }
+            finish(MODBUS_DONE, pdu, pdu_len);
+            sb.gbump(len);
+        }
+
+        // check a frame, converting an ASCII frame to binary in place
+        bool decode(char* s, size_t n, size_t* pdu_len) {
+            if (_mode == MODBUS_RTU) {
+                if (n < 4 || crc16_modbus(s, n)) {
+                    return false;
+                }
+                *pdu_len = n - 3;
+                return true;
+            }
+
+            // ':' + hex pairs + CR LF
+            if (n < 9 || (n - 3) % 2 || s[n - 2] != '\r') {
+                return false;
+            }
+            size_t m = (n - 3) / 2;
+            unsigned char lrc = 0;
+            for (size_t i = 0; i < m; ++i) {
+                int hi = modbus_hex(s[1 + 2 * i]);
+                int lo = modbus_hex(s[2 + 2 * i]);
+                if (hi < 0 || lo < 0) {
+                    return false;
+                }
+                s[i] = (char) (hi << 4 | lo);
+                lrc = (unsigned char) (lrc + (unsigned char) s[i]);
+            }
+            if (lrc) {
+                return false;
+            }
+            *pdu_len = m - 2;
+            return true;
+        }
+
+        void finish(modbus_status status, const char* pdu, size_t len) {
+            modbus_request* r = _queue[_head];
+            _head = (_head + 1) % UIO_MODBUS_QUEUE;
+            --_count;
+            _active = false;
+            r->status = status;
+            completed(*r, pdu, len);
+        }
+
+        iostream& _bus;
+        modbus_mode _mode;
+        uint32_t _t35;
+        modbus_request* _queue[UIO_MODBUS_QUEUE];
+        size_t _head;
+        size_t _count;
+        bool _active;
+        bool _heard;
+        uint32_t _last;
+        uint32_t _sent;
+        uint32_t _unmatched;
+    };
+};
+
+#endif // UIO_MODBUS_H
@@ -0,0 +1,293 @@
+#ifndef UIO_NMEA_H
+#define UIO_NMEA_H
+/**
+ * @file
+ * @brief In-place NMEA 0183 sentence parser.
+ *
+ * \par
+ * A \ref uio::nmea_parser finds \c $...*hh sentences (and \c !... AIS
+ * sentences) in an input stream's buffer, checks their XOR checksum, and
+ * splits them into fields. Fields are views into the input buffer, so
+ * nothing is allocated or copied:
+ *
+ * \code
+ * uio::nmea_sentence s;
+ * while (gps.next(&s)) {
+ *     if (s.is("GGA")) {
+ *         uio::nmea_field lat = s.field(2);
+ *         ...
+ *     }
+ * }
+ * \endcode
+ *
+ * \par
+ * Line ends are found with \c memchr and checksums are computed a machine
+ * word at a time, so parsing costs about one pass over the input.
+ */
+#include <stdint.h>
+#include "uio.hpp"
+
+#ifndef UIO_NMEA_FIELDS
+/**
+ * @brief Maximum number of fields (including the address field) in a
+ * \ref uio::nmea_sentence. Further fields are ignored.
+ */
+#define UIO_NMEA_FIELDS 24
+#endif
+
+namespace uio {
+
+    /**
+     * @brief A field of a sentence, in the input buffer.
+     *
+     * The field is not null-terminated.
+     */
+    struct nmea_field {
+        const char* data;   ///< First character of the field.
+        size_t len;         ///< Number of characters in the field.
+    };
+
+    /**
+     * @brief A parsed sentence.
+     *
+     * The sentence is valid until the parser that filled it is advanced
+     * or released.
+     */
+    class nmea_sentence {
+    public:
+        nmea_sentence() {
+            _count = 0;
+        }
+
+        /**
+         * @brief Get the number of fields.
+         *
+         * @returns The number of fields, including the address field.
+         */
+        inline size_t fields() const {
+            return _count;
+        }
+
+        /**
+         * @brief Get a field.
+         *
+         * @param[in] i The field's index; 0 is the address field (e.g.
+         * \c GPGGA).
+         *
+         * @returns The field, which is empty if \a i is out of range.
+         */
+        nmea_field field(size_t i) const {
+            nmea_field f = { "", 0 };
+            if (i < _count && i < UIO_NMEA_FIELDS) {
+                f.data = _start[i];
+                f.len = _start[i + 1] - _start[i] - 1;
+            }
+            return f;
+        }
+
+        /**
+         * @brief Check the sentence formatter (the address field without
+         * its talker ID).
+         *
+         * @param[in] type The formatter, e.g. \c "GGA".
+         *
+         * @returns \c true if the address field ends with \a type.
+         */
+        bool is(const char* type) const {
+            nmea_field a = field(0);
+            size_t n = strlen(type);
+            return a.len >= n && !memcmp(a.data + a.len - n, type, n);
+        }
+
+    private:
+        friend class nmea_parser;
+
+        // field i is [_start[i], _start[i + 1] - 1)
+        const char* _start[UIO_NMEA_FIELDS + 1];
+        size_t _count;
+    };
+
+    /// \cond DO_NOT_DOCUMENT
+    // XOR of the bytes in [s, s + n)
+    inline unsigned char nmea_checksum(const char* s, size_t n) {
+        size_t w = 0;
+        size_t i = 0;
+        for (; i + sizeof(size_t) <= n; i += sizeof(size_t)) {
+            size_t v;
+            memcpy(&v, s + i, sizeof(v));
+            w ^= v;
+        }
+        for (size_t sh = sizeof(size_t) * 4; sh >= 8; sh /= 2) {
+            w ^= w >> sh;
+        }
+        unsigned char c = (unsigned char) w;
+        for (; i < n; ++i) {
+            c ^= (unsigned char) s[i];
+        }
+        return c;
+    }
+
+    inline int nmea_hex(char c) {
+        if (c >= '0' && c <= '9') {
+            return c - '0';
+        }
+        if (c >= 'A' && c <= 'F') {
+            return c - 'A' + 10;
+        }
+        if (c >= 'a' && c <= 'f') {
+            return c - 'a' + 10;
+        }
+        return -1;
+    }
+    /// \endcond
+
+    /**
+     * @brief A parser of the sentences in an input stream.
+     *
+     * Sentences are parsed in place in the stream's input buffer, so the
+     * longest line must fit in that buffer. Sentences with a wrong
+     * checksum are dropped and set the stream's \c _ierror._flags.corrupt;
+     * lines that do not fit are dropped and set its
+     * \c _ierror._flags.overflow. Sentences without a checksum are
+     * accepted.
+     */
+    class nmea_parser {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to parse.
+         */
+        explicit nmea_parser(istream& link) : _link(link) {
+            _scan = 0;
+            _line = 0;
+            _errors = 0;
+        }
+
+        /**
+         * @brief Get the next sentence.
+         *
+         * The previous sentence is released first. The stream is synced
+         * (at most once) if the buffered input does not hold a complete
+         * sentence.
+         *
+         * @param[out] s The sentence.
+         *
+         * @returns \c true if a sentence was parsed.
+         */
+        bool next(nmea_sentence* s) {
+            release();
+            for (bool synced = false; ; synced = true) {
+                if (parse(s)) {
+                    return true;
+                }
+                if (synced) {
+                    return false;
+                }
+
+                // make room at the back for the rest of the line
+                streambuf& sb = _link.ibuf();
+                sb.compact();
+                if (sb.in_avail() && sb.pptr() == sb.epptr()) {
+                    ++_errors;
+                    _link._ierror._flags.overflow = true;
+                    sb.gbump(sb.in_avail());
+                    _scan = 0;
+                }
+                _link.sync();
+            }
+        }
+
+        /**
+         * @brief Release the last sentence's space in the input buffer.
+         */
+        void release() {
+            if (_line) {
+                _link.ibuf().gbump(_line);
+                _line = 0;
+            }
+        }
+
+        /**
+         * @brief Get the number of lines that have been dropped.
+         *
+         * @returns The number of corrupt and oversized lines.
+         */
+        inline uint32_t errors() const {
+            return _errors;
+        }
+
+    private:
+        bool parse(nmea_sentence* s) {
+            streambuf& sb = _link.ibuf();
+            for (;;) {
+                const char* base = sb.gptr();
+                size_t n = sb.in_avail();
+                const char* lf = (const char*) memchr(base + _scan, '\n',
+                    n - _scan);
+                if (!lf) {
+                    _scan = n;
+                    return false;
+                }
+                size_t len = lf - base + 1;
+                _scan = 0;
+                if (split(s, base, lf)) {
+                    _line = len;
+                    return true;
+                }
+                sb.gbump(len);
+            }
+        }
+
+        // parse the line [base, lf)
+        bool split(nmea_sentence* s, const char* base, const char* lf) {
+            const char* end = lf;
+            if (end > base && end[-1] == '\r') {
+                --end;
+            }
+
+            // the sentence starts at the first '$' or '!'
+            const char* start = (const char*) memchr(base, '$', end - base);
+            const char* bang = (const char*) memchr(base, '!',
+                (start ? start : end) - base);
+            start = bang ? bang : start;
+            if (!start) {
+                return false;
+            }
+            ++start;
+
+            if (end - start >= 3 && end[-3] == '*') {
+                int hi = nmea_hex(end[-2]);
+                int lo = nmea_hex(end[-1]);
+                end -= 3;
+                if (hi < 0 || lo < 0
+                    || nmea_checksum(start, end - start) != (hi << 4 | lo)) {
+                    ++_errors;
+                    _link._ierror._flags.corrupt = true;
+                    return false;
+                }
+            }
+
+            size_t count = 0;
+            const char* f = start;
+            while (count < UIO_NMEA_FIELDS) {
+                s->_start[count++] = f;
+                const char* comma = (const char*) memchr(f, ',', end - f);
+                f = (comma ? comma : end) + 1;
+                if (!comma) {
+                    break;
+                }
+            }
+            s->_start[count] = f;
+            s->_count = count;
+            return true;
+        }
+
+        istream& _link;
+        size_t _scan;
+        size_t _line;
+        uint32_t _errors;
+    };
+};
+
+#endif // UIO_NMEA_H
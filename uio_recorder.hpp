@@ -0,0 +1,547 @@
+#ifndef UIO_RECORDER_H
+#define UIO_RECORDER_H
+/**
+ * @file
+ * @brief Flight-recorder output streams.
+ *
+ * \par
+ * A flight recorder is an \ref uio::ostream that never fails or blocks.
+ * Output data is kept in a ring of records, and when the ring is full the
+ * oldest complete records are overwritten, so the ring always holds the
+ * most recent activity (e.g. for a crash dump).
+ *
+ * \par
+ * A \ref uio::persistent_recorder keeps its ring, and the ring's state, in
+ * memory that outlives the process (e.g. an \c mmap'd file or a \c .noinit
+ * RAM section), so the records survive a crash.
+ */
+#include <stdint.h>
+#include "uio.hpp"
+
+#if defined(__GNUC__)
+/// \cond DO_NOT_DOCUMENT
+#define UIO_STORE_FENCE() __atomic_thread_fence(__ATOMIC_RELEASE)
+/// \endcond
+#elif __cplusplus >= 201103L
+#include <atomic>
+/// \cond DO_NOT_DOCUMENT
+#define UIO_STORE_FENCE() std::atomic_thread_fence(std::memory_order_release)
+/// \endcond
+#else
+#error "uio_recorder.hpp needs a store fence for this compiler"
+#endif
+
+namespace uio {
+
+    /**
+     * @brief An output stream that overwrites its oldest records.
+     *
+     * Bytes written with \ref put, \ref write, \ref operator<<, and
+     * \c printf are appended to the open record, and \ref flush commits
+     * the open record. Each record is stored as a two-byte length followed
+     * by its data. The committed records can be read back, oldest first,
+     * with \ref next.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class flight_recorder : public ostream {
+    public:
+        /**
+         * @brief Default constructor.
+         */
+        flight_recorder() {
+            _ring = NULL;
+            _capacity = 0;
+            _head = 0;
+            _used = 0;
+            _open = 0;
+            _count = 0;
+            _oerror._flags.uninitialized = true;
+        }
+
+        /**
+         * @brief Initialize the ring.
+         *
+         * @attention This function \em must be called before the ring can
+         * be used.
+         *
+         * @param buf Memory allocation for the ring.
+         * @param capacity Size of the ring (i.e. size of \a buf).
+         *
+         * @returns \c this
+         */
+        flight_recorder* setbuf(char* buf, size_t capacity) {
+            _ring = buf;
+            _capacity = capacity;
+            _head = 0;
+            _used = 0;
+            _open = 0;
+            _count = 0;
+            _oerror._flags.uninitialized = (_ring == NULL || capacity <= 2);
+            return this;
+        }
+
+        virtual ostream& operator<<(const char* s) {
+            return write(s, strlen(s));
+        }
+
+        virtual ostream& put(char c) {
+            return write(&c, 1);
+        }
+
+        virtual ostream& vprintf(const char* format, va_list args) {
+            return vprintf_write(format, args);
+        }
+
+        /**
+         * @brief Append \a n bytes from \a s to the open record.
+         *
+         * The oldest committed records are dropped to make room for the new
+         * bytes.
+         *
+         * @note \c _oerror._flags.overflow is set if the open record does
+         * not fit in the ring (the bytes that do not fit are dropped).
+         *
+         * @returns \c *this
+         */
+        virtual ostream& write(const char* s, size_t n) {
+            if (_oerror._flags.uninitialized) {
+                return *this;
+            }
+
+            // drop the oldest records until the new bytes fit
+            while (_count && _used + 2 + _open + n > _capacity) {
+                size_t len = (unsigned char) _ring[_head]
+                    | (unsigned char) _ring[wrap(_head + 1)] << 8;
+                _head = wrap(_head + 2 + len);
+                _used -= 2 + len;
+                --_count;
+            }
+
+            size_t m = min(min(n, _capacity - 2 - _used - _open),
+                (size_t) 0xFFFF - _open);
+            copyin(wrap(_head + _used + 2 + _open), s, m);
+            _open += m;
+            if (m != n) {
+                _oerror._flags.overflow = true;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Commit the open record.
+         *
+         * @returns \c *this
+         */
+        virtual ostream& flush() {
+            if (_open) {
+                size_t tail = wrap(_head + _used);
+                _ring[tail] = (char) _open;
+                _ring[wrap(tail + 1)] = (char) (_open >> 8);
+                _used += 2 + _open;
+                _open = 0;
+                ++_count;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Get the number of committed records in the ring.
+         *
+         * @returns The number of records that can be read with \ref next.
+         */
+        inline size_t records() const {
+            return _count;
+        }
+
+        /**
+         * @brief Copy the next committed record to \a s.
+         *
+         * Records are read oldest first. Set \a cursor to 0 to read the
+         * oldest record; it is advanced to the next record on return.
+         *
+         * @attention \a cursor is invalidated by \ref write.
+         *
+         * @param[in,out] cursor Position of the record in the ring.
+         * @param[out] s Address to begin copying to.
+         * @param[in] len Maximum number of bytes to copy.
+         *
+         * @returns The number of bytes copied to \a s, or 0 if there are no
+         * more records. Records longer than \a len are truncated.
+         */
+        size_t next(size_t* cursor, char* s, size_t len) const {
+            if (*cursor >= _used) {
+                return 0;
+            }
+            size_t pos = wrap(_head + *cursor);
+            size_t n = (unsigned char) _ring[pos]
+                | (unsigned char) _ring[wrap(pos + 1)] << 8;
+            *cursor += 2 + n;
+            n = min(n, len);
+            copyout(s, wrap(pos + 2), n);
+            return n;
+        }
+
+    private:
+        size_t wrap(size_t pos) const {
+            return pos >= _capacity ? pos - _capacity : pos;
+        }
+
+        void copyin(size_t pos, const char* s, size_t n) {
+            size_t m = min(n, _capacity - pos);
+            memcpy(_ring + pos, s, m);
+            memcpy(_ring, s + m, n - m);
+        }
+
+        void copyout(char* s, size_t pos, size_t n) const {
+            size_t m = min(n, _capacity - pos);
+            memcpy(s, _ring + pos, m);
+            memcpy(s + m, _ring, n - m);
+        }
+
+        char* _ring;
+        size_t _capacity;
+        size_t _head;
+        size_t _used;
+        size_t _open;
+        size_t _count;
+    };
+
+    /**
+     * @brief A flight recorder whose records survive a crash.
+     *
+     * The ring lives in memory provided by the application, such as an
+     * \c mmap'd file, behind a small header holding the position and 
+     * sequence number of the oldest record. Each record is stored as
+     * an eight-byte header (sequence number, length, and a Fletcher-16 
+     * checksum of the header and data) followed by its data.
+     *
+     * Record data is written before its header, and the ring's header is 
+     * updated before any bytes of an overwritten record are reused, so a 
+     * crash at any point leaves a consistent chain of records. \ref setbuf
+     * recovers them by following the valid, consecutively numbered records
+     * from the oldest one. Nothing is synchronized to storage on the hot path; 
+     * surviving power loss additionally requires the application to 
+     * periodically \c msync the memory.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class persistent_recorder : public ostream {
+    public:
+        /**
+         * @brief Default constructor.
+         */
+        persistent_recorder() {
+            _hdr = NULL;
+            _ring = NULL;
+            _capacity = 0;
+            _head = 0;
+            _used = 0;
+            _open = 0;
+            _count = 0;
+            _seq = 0;
+            _sum1 = 0;
+            _sum2 = 0;
+            _oerror._flags.uninitialized = true;
+        }
+
+        /**
+         * @brief Attach the recorder to its memory and recover its records.
+         *
+         * If \a buf already holds a ring of the same size, the records that
+         * were committed before the previous owner stopped (or crashed) are
+         * recovered. Otherwise the ring is formatted.
+         *
+         * @attention This function \em must be called before the ring can
+         * be used. \a buf must be aligned to 4 bytes.
+         *
+         * @param buf Memory for the ring (and its header).
+         * @param capacity Size of \a buf.
+         *
+         * @returns \c this
+         */
+        persistent_recorder* setbuf(char* buf, size_t capacity) {
+            _hdr = (header*) buf;
+            _ring = buf + sizeof(header);
+            _capacity = capacity > sizeof(header) + 8 ? 
+                min(capacity - sizeof(header), (size_t) 0xFFFFFFFF) : 0;
+            _head = 0;
+            _used = 0;
+            _open = 0;
+            _count = 0;
+            _seq = 0;
+            _oerror._flags.uninitialized = (buf == NULL || _capacity == 0);
+            if (_oerror._flags.uninitialized) {
+                return this;
+            }
+
+            if (_hdr->magic == MAGIC && _hdr->capacity == _capacity
+                && _hdr->head < _capacity) {
+                recover();
+            } else {
+                _hdr->magic = 0;
+                UIO_STORE_FENCE();
+                _hdr->capacity = (uint32_t) _capacity;
+                _hdr->head = 0;
+                _hdr->head_seq = 0;
+                UIO_STORE_FENCE();
+                _hdr->magic = MAGIC;
+            }
+            return this;
+        }
+
+        virtual ostream& operator<<(const char* s) {
+            return write(s, strlen(s));
+        }
+
+        virtual ostream& put(char c) {
+            return write(&c, 1);
+        }
+
+        virtual ostream& vprintf(const char* format, va_list args) {
+            return vprintf_write(format, args);
+        }
+
+        /**
+         * @brief Append \a n bytes from \a s to the open record.
+         *
+         * The oldest committed records are dropped to make room for the new
+         * bytes.
+         *
+         * @note \c _oerror._flags.overflow is set if the open record does
+         * not fit in the ring (the bytes that do not fit are dropped).
+         *
+         * @returns \c *this
+         */
+        virtual ostream& write(const char* s, size_t n) {
+            if (_oerror._flags.uninitialized) {
+                return *this;
+            }
+
+            // drop the oldest records until the new bytes fit
+            if (_count && _used + 8 + _open + n > _capacity) {
+                while (_count && _used + 8 + _open + n > _capacity) {
+                    size_t len = reclen(_head);
+                    _head = wrap(_head + 8 + len);
+                    _used -= 8 + len;
+                    --_count;
+                }
+                _hdr->head_seq = _seq - (uint32_t) _count;
+                UIO_STORE_FENCE();
+                _hdr->head = (uint32_t) _head;
+                UIO_STORE_FENCE();
+            }
+
+            size_t m = min(min(n, _capacity - 8 - _used - _open),
+                (size_t) 0xFFFF - _open);
+            copyin(wrap(_head + _used + 8 + _open), s, m);
+            checksum(s, m);
+            _open += m;
+            if (m != n) {
+                _oerror._flags.overflow = true;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Commit the open record.
+         *
+         * @returns \c *this
+         */
+        virtual ostream& flush() {
+            if (_open) {
+                char rec[8];
+                encode(rec, _seq, _open);
+                checksum(rec, 6);
+                _sum1 %= 255;
+                _sum2 %= 255;
+                rec[6] = (char) _sum1;
+                rec[7] = (char) _sum2;
+
+                // publish the record once its data is in place
+                UIO_STORE_FENCE();
+                copyin(wrap(_head + _used), rec, 8);
+                UIO_STORE_FENCE();
+                ++_seq;
+
+                _used += 8 + _open;
+                _open = 0;
+                _sum1 = 0;
+                _sum2 = 0;
+                ++_count;
+            }
+            return *this;
+        }
+
+        /**
+         * @brief Get the number of committed records in the ring.
+         *
+         * @returns The number of records that can be read with \ref next.
+         */
+        inline size_t records() const {
+            return _count;
+        }
+
+        /**
+         * @brief Get the sequence number of the next record.
+         *
+         * @returns The number of records that have ever been committed to
+         * the ring.
+         */
+        inline uint32_t sequence() const {
+            return _seq;
+        }
+
+        /**
+         * @brief Copy the next committed record to \a s.
+         *
+         * Records are read oldest first. Set \a cursor to 0 to read the
+         * oldest record; it is advanced to the next record on return.
+         *
+         * @attention \a cursor is invalidated by \ref write.
+         *
+         * @param[in,out] cursor Position of the record in the ring.
+         * @param[out] s Address to begin copying to.
+         * @param[in] len Maximum number of bytes to copy.
+         *
+         * @returns The number of bytes copied to \a s, or 0 if there are no
+         * more records. Records longer than \a len are truncated.
+         */
+        size_t next(size_t* cursor, char* s, size_t len) const {
+            if (*cursor >= _used) {
+                return 0;
+            }
+            size_t pos = wrap(_head + *cursor);
+            size_t n = reclen(pos);
+            *cursor += 8 + n;
+            n = min(n, len);
+            copyout(s, wrap(pos + 8), n);
+            return n;
+        }
+
+    private:
+        static const uint32_t MAGIC = 0x52545255; // "URTR"
+
+        struct header {
+            volatile uint32_t magic;
+            volatile uint32_t capacity;
+            volatile uint32_t head;
+            volatile uint32_t head_seq;
+        };
+
+        void recover() {
+            // records older than head_seq were dropped before the crash,
+            // but the crash came before head was moved past them
+            size_t pos = _hdr->head;
+            uint32_t seq = _hdr->head_seq;
+            size_t scanned = 0;
+            _head = pos;
+            while (scanned + 8 <= _capacity) {
+                char rec[8];
+                copyout(rec, pos, 8);
+                uint32_t rseq = (unsigned char) rec[0] 
+                    | (uint32_t) (unsigned char) rec[1] << 8
+                    | (uint32_t) (unsigned char) rec[2] << 16 
+                    | (uint32_t) (unsigned char) rec[3] << 24;
+                size_t len = (unsigned char) rec[4] 
+                    | (unsigned char) rec[5] << 8;
+                bool dropped = !_count && rseq - seq >= 0x80000000u;
+                if ((!dropped && rseq != seq) || len == 0 
+                    || scanned + 8 + len > _capacity) {
+                    break;
+                }
+
+                // verify the record's checksum
+                _sum1 = 0;
+                _sum2 = 0;
+                size_t p = wrap(pos + 8);
+                size_t m = min(len, _capacity - p);
+                checksum(_ring + p, m);
+                checksum(_ring, len - m);
+                checksum(rec, 6);
+                if (_sum1 % 255 != (unsigned char) rec[6] 
+                    || _sum2 % 255 != (unsigned char) rec[7]) {
+                    break;
+                }
+
+                pos = wrap(pos + 8 + len);
+                scanned += 8 + len;
+                if (dropped) {
+                    _head = pos;
+                    _used = 0;
+                } else {
+                    _used += 8 + len;
+                    ++_count;
+                    ++seq;
+                }
+            }
+            _sum1 = 0;
+            _sum2 = 0;
+            _seq = seq;
+            _hdr->head_seq = _seq - (uint32_t) _count;
+            UIO_STORE_FENCE();
+            _hdr->head = (uint32_t) _head;
+            UIO_STORE_FENCE();
+        }
+
+        static void encode(char* rec, uint32_t seq, size_t len) {
+            rec[0] = (char) seq;
+            rec[1] = (char) (seq >> 8);
+            rec[2] = (char) (seq >> 16);
+            rec[3] = (char) (seq >> 24);
+            rec[4] = (char) len;
+            rec[5] = (char) (len >> 8);
+        }
+
+        void checksum(const char* s, size_t n) {
+            // the sums are reduced often enough that they can not overflow
+            while (n) {
+                size_t m = min(n, (size_t) 256);
+                for (size_t i = 0; i < m; ++i) {
+                    _sum1 += (unsigned char) s[i];
+                    _sum2 += _sum1;
+                }
+                _sum1 %= 255;
+                _sum2 %= 255;
+                s += m;
+                n -= m;
+            }
+        }
+
+        size_t reclen(size_t pos) const {
+            return (unsigned char) _ring[wrap(pos + 4)]
+                | (unsigned char) _ring[wrap(pos + 5)] << 8;
+        }
+
+        size_t wrap(size_t pos) const {
+            return pos >= _capacity ? pos - _capacity : pos;
+        }
+
+        void copyin(size_t pos, const char* s, size_t n) {
+            size_t m = min(n, _capacity - pos);
+            memcpy(_ring + pos, s, m);
+            memcpy(_ring, s + m, n - m);
+        }
+
+        void copyout(char* s, size_t pos, size_t n) const {
+            size_t m = min(n, _capacity - pos);
+            memcpy(s, _ring + pos, m);
+            memcpy(s + m, _ring, n - m);
+        }
+
+        header* _hdr;
+        char* _ring;
+        size_t _capacity;
+        size_t _head;
+        size_t _used;
+        size_t _open;
+        size_t _count;
+        uint32_t _seq;
+        uint32_t _sum1;
+        uint32_t _sum2;
+    };
+};
+
+#endif // UIO_RECORDER_H
@@ -0,0 +1,159 @@
+#ifndef UIO_STD_H
+#define UIO_STD_H
+/**
+ * @file
+ * @brief Standard library iostreams interop.
+ *
+ * \par
+ * A \ref uio::std_streambuf exposes uio streams as a \c std::streambuf, so
+ * code written against \c std::ostream and \c std::istream can use them:
+ *
+ * \code
+ * uio::std_streambuf sb(uart);
+ * std::ostream out(&sb);
+ * out << "T=" << temperature << std::endl;   // std::endl flushes uart
+ * \endcode
+ *
+ * \par
+ * The \c std::streambuf put area is the free region of the uio output
+ * buffer, and its get area is the readable region of the uio input buffer.
+ * Standard streams therefore format straight into (and parse straight out
+ * of) uio buffer memory, with no intermediate buffer or copy.
+ */
+#include <streambuf>
+#include "uio.hpp"
+
+namespace uio {
+
+    /**
+     * @brief A \c std::streambuf over uio streams' buffers.
+     *
+     * Bytes put through the adapter are committed to the output buffer,
+     * and bytes got through it are consumed from the input buffer, when
+     * the adapter overflows (underflows) or is synced.
+     *
+     * @attention Call \c pubsync() (e.g. flush the \c std::ostream) before
+     * using the uio streams directly, and do not use the uio streams while
+     * a standard stream is in the middle of an operation. Bytes are
+     * written to the output buffer directly, so an overridden
+     * \ref ostream::write is not called.
+     */
+    class std_streambuf : public std::streambuf {
+    public:
+        /**
+         * @brief Construct an adapter that writes to \a os.
+         *
+         * @param[in] os Output stream.
+         */
+        explicit std_streambuf(ostream& os) {
+            init(NULL, &os);
+        }
+
+        /**
+         * @brief Construct an adapter that reads from \a is.
+         *
+         * @param[in] is Input stream.
+         */
+        explicit std_streambuf(istream& is) {
+            init(&is, NULL);
+        }
+
+        /**
+         * @brief Construct an adapter that reads from and writes to \a ios.
+         *
+         * @param[in] ios Input/output stream.
+         */
+        explicit std_streambuf(iostream& ios) {
+            init(&ios, &ios);
+        }
+
+        /**
+         * @brief Destructor. Pending bytes are committed but not flushed.
+         */
+        virtual ~std_streambuf() {
+            commit();
+        }
+
+    protected:
+        /**
+         * @brief Flush the output stream once the output buffer is full.
+         */
+        virtual int_type overflow(int_type c) {
+            if (!_os) {
+                return traits_type::eof();
+            }
+            commit();
+            streambuf& sb = _os->obuf();
+            if (sb.pptr() == sb.epptr()) {
+                _os->flush();
+            }
+            setp(sb.pptr(), sb.epptr());
+            if (traits_type::eq_int_type(c, traits_type::eof())) {
+                return traits_type::not_eof(c);
+            }
+            if (pptr() == epptr()) {
+                _os->_oerror._flags.overflow = true;
+                _os->_oerror |= sb._error;
+                return traits_type::eof();
+            }
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+            return c;
+        }
+
+        /**
+         * @brief Sync the input stream once the input buffer is empty.
+         */
+        virtual int_type underflow() {
+            if (!_is) {
+                return traits_type::eof();
+            }
+            commit();
+            streambuf& sb = _is->ibuf();
+            if (!sb.in_avail()) {
+                _is->sync();
+            }
+            setg(sb.gptr(), sb.gptr(), sb.egptr());
+            return gptr() == egptr() ? traits_type::eof()
+                : traits_type::to_int_type(*gptr());
+        }
+
+        /**
+         * @brief Commit pending bytes and flush the output stream.
+         */
+        virtual int sync() {
+            commit();
+            if (_os) {
+                _os->flush();
+                streambuf& sb = _os->obuf();
+                setp(sb.pptr(), sb.epptr());
+            }
+            return 0;
+        }
+
+    private:
+        void init(istream* is, ostream* os) {
+            _is = is;
+            _os = os;
+            setg(NULL, NULL, NULL);
+            setp(NULL, NULL);
+        }
+
+        // hand the bytes put (got) so far to the uio buffers
+        void commit() {
+            if (_os && pptr() != pbase()) {
+                _os->obuf().pbump(pptr() - pbase());
+                setp(pptr(), epptr());
+            }
+            if (_is && gptr() != eback()) {
+                _is->ibuf().gbump(gptr() - eback());
+                setg(gptr(), gptr(), egptr());
+            }
+        }
+
+        istream* _is;
+        ostream* _os;
+    };
+};
+
+#endif // UIO_STD_H
@@ -0,0 +1,367 @@
+#ifndef UIO_UTF8_H
+#define UIO_UTF8_H
+/**
+ * @file
+ * @brief UTF-8 validating and UTF-16 transcoding input streams.
+ *
+ * \par
+ * A \ref uio::utf8_istream reads another input stream and only lets
+ * through well-formed UTF-8, made of complete code points. Each newly
+ * synced region is validated in one pass; invalid bytes are replaced with
+ * U+FFFD and set \c _ierror._flags.corrupt. A \ref uio::utf16_istream
+ * does the same and delivers UTF-16 code units instead.
+ *
+ * \par
+ * Where SSSE3 is available, regions are validated 16 bytes at a time with
+ * three nibble lookup tables (\c pshufb), after Keiser and Lemire,
+ * "Validating UTF-8 In Less Than One Instruction Per Byte". Elsewhere,
+ * runs of ASCII are skipped a machine word at a time.
+ */
+#include <stdint.h>
+#include "uio.hpp"
+
+#if defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+namespace uio {
+
+    /// \cond DO_NOT_DOCUMENT
+    // length of the longest prefix of [s, s + n) that is well-formed UTF-8;
+    // *truncated is set if it stops at a code point that is cut off by n
+    inline size_t utf8_check(const char* s, size_t n, bool* truncated) {
+        const unsigned char* u = (const unsigned char*) s;
+        const size_t high = (size_t) -1 / 0xFF * 0x80;
+        size_t i = 0;
+        *truncated = false;
+        while (i < n) {
+            size_t w;
+            if (i + sizeof(w) <= n) {
+                memcpy(&w, u + i, sizeof(w));
+                if (!(w & high)) {
+                    i += sizeof(w);
+                    continue;
+                }
+            }
+
+            unsigned char c = u[i];
+            if (c < 0x80) {
+                ++i;
+                continue;
+            }
+            size_t len;
+            unsigned char lo = 0x80;
+            unsigned char hi = 0xBF;
+            if (c >= 0xC2 && c <= 0xDF) {
+                len = 2;
+            } else if (c >= 0xE0 && c <= 0xEF) {
+                len = 3;
+                lo = c == 0xE0 ? 0xA0 : lo;     // overlong
+                hi = c == 0xED ? 0x9F : hi;     // surrogates
+            } else if (c >= 0xF0 && c <= 0xF4) {
+                len = 4;
+                lo = c == 0xF0 ? 0x90 : lo;     // overlong
+                hi = c == 0xF4 ? 0x8F : hi;     // above U+10FFFF
+            } else {
+                return i;
+            }
+
+            size_t k = 1;
+            for (; k < len && i + k < n; ++k) {
+                unsigned char d = u[i + k];
+                if (d < (k == 1 ? lo : 0x80) || d > (k == 1 ? hi : 0xBF)) {
+                    return i;
+                }
+            }
+            if (k < len) {
+                *truncated = true;
+                return i;
+            }
+            i += len;
+        }
+        return i;
+    }
+
+    // the end of the last complete code point in [s, s + n)
+    inline size_t utf8_boundary(const char* s, size_t n) {
+        for (size_t k = 1; k <= 3 && k <= n; ++k) {
+            unsigned char c = (unsigned char) s[n - k];
+            if ((c & 0xC0) != 0x80) {
+                size_t len = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+                return len > k ? n - k : n;
+            }
+        }
+        return n;
+    }
+
+#if defined(__SSSE3__)
+    // check that [s, s + n) is well-formed UTF-8 made of complete code points
+    inline bool utf8_validate(const char* s, size_t n) {
+        // the error classes that each nibble can take part in: too short
+        // (1), too long (2), overlong 3-byte (4), too large (8), surrogate
+        // (16), overlong 2-byte (32), too large or overlong 4-byte (64) and
+        // two continuations (128)
+        const __m128i byte_1_high = _mm_setr_epi8(
+            2, 2, 2, 2, 2, 2, 2, 2,
+            (char) 128, (char) 128, (char) 128, (char) 128,
+            33, 1, 21, 73);
+        const __m128i byte_1_low = _mm_setr_epi8(
+            (char) 231, (char) 163, (char) 131, (char) 131,
+            (char) 139, (char) 203, (char) 203, (char) 203,
+            (char) 203, (char) 203, (char) 203, (char) 203,
+            (char) 203, (char) 219, (char) 203, (char) 203);
+        const __m128i byte_2_high = _mm_setr_epi8(
+            1, 1, 1, 1, 1, 1, 1, 1,
+            (char) 230, (char) 174, (char) 186, (char) 186,
+            1, 1, 1, 1);
+        // leads that need more bytes than are left in the block
+        const __m128i last = _mm_setr_epi8(
+            -1, -1, -1, -1, -1, -1, -1, -1,
+            -1, -1, -1, -1, -1, (char) 0xEF, (char) 0xDF, (char) 0xBF);
+        const __m128i nibble = _mm_set1_epi8(0x0F);
+        const __m128i zero = _mm_setzero_si128();
+
+        __m128i prev = zero;
+        __m128i incomplete = zero;
+        __m128i error = zero;
+        for (size_t i = 0; i < n; i += 16) {
+            __m128i in;
+            if (i + 16 <= n) {
+                in = _mm_loadu_si128((const __m128i*) (s + i));
+            } else {
+                char tail[16] = { 0 };
+                memcpy(tail, s + i, n - i);
+                in = _mm_loadu_si128((const __m128i*) tail);
+            }
+
+            if (!_mm_movemask_epi8(in)) {
+                // ASCII
+                error = _mm_or_si128(error, incomplete);
+                incomplete = zero;
+                prev = in;
+                continue;
+            }
+
+            __m128i prev1 = _mm_alignr_epi8(in, prev, 15);
+            __m128i special = _mm_and_si128(_mm_and_si128(
+                _mm_shuffle_epi8(byte_1_high,
+                    _mm_and_si128(_mm_srli_epi16(prev1, 4), nibble)),
+                _mm_shuffle_epi8(byte_1_low, _mm_and_si128(prev1, nibble))),
+                _mm_shuffle_epi8(byte_2_high,
+                    _mm_and_si128(_mm_srli_epi16(in, 4), nibble)));
+
+            // 3rd and 4th bytes must be continuations
+            __m128i third = _mm_subs_epu8(_mm_alignr_epi8(in, prev, 14),
+                _mm_set1_epi8((char) (0xE0 - 0x80)));
+            __m128i fourth = _mm_subs_epu8(_mm_alignr_epi8(in, prev, 13),
+                _mm_set1_epi8((char) (0xF0 - 0x80)));
+            __m128i must = _mm_and_si128(_mm_or_si128(third, fourth),
+                _mm_set1_epi8((char) 0x80));
+            error = _mm_or_si128(error, _mm_xor_si128(must, special));
+
+            incomplete = _mm_subs_epu8(in, last);
+            prev = in;
+        }
+        error = _mm_or_si128(error, incomplete);
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(error, zero)) == 0xFFFF;
+    }
+#endif
+    /// \endcond
+
+    /**
+     * @brief An input stream that validates the UTF-8 of another stream.
+     *
+     * \ref sync syncs the source and moves the well-formed part of its
+     * input into this stream's buffer. A code point that is cut off at the
+     * end of the source's input is held back until the rest arrives.
+     *
+     * @note \c _ierror._flags.corrupt is set when invalid bytes are
+     * replaced with U+FFFD.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class utf8_istream : public istream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to read.
+         */
+        explicit utf8_istream(istream& link) : _link(link) {}
+
+        /**
+         * @brief Initialize the input buffer.
+         *
+         * @param buf Memory allocation for the input buffer.
+         * @param capacity Size of the buffer.
+         *
+         * @returns \c this
+         */
+        inline utf8_istream* setbuf(char* buf, size_t capacity) {
+            _ibuf.setbuf(buf, capacity);
+            return this;
+        }
+
+        virtual istream& sync() {
+            if (_ibuf._error._flags.uninitialized) {
+                return *this;
+            }
+            _ibuf.compact();
+            _link.ibuf().compact(); // make room after a truncated sequence
+            _link.sync();
+            streambuf& sb = _link.ibuf();
+            for (;;) {
+                size_t n = min(room(), sb.in_avail());
+                if (!n) {
+                    break;
+                }
+                const char* s = sb.gptr();
+                bool truncated = false;
+                size_t ok = 0;
+#if defined(__SSSE3__)
+                size_t m = utf8_boundary(s, n);
+                if (m && utf8_validate(s, m)) {
+                    ok = m;
+                } else
+#endif
+                ok = utf8_check(s, n, &truncated);
+
+                if (ok) {
+                    put(s, ok);
+                    sb.gbump(ok);
+                    continue;
+                }
+                if (truncated || room() < 3) {
+                    break;
+                }
+                put("\xEF\xBF\xBD", 3);
+                sb.gbump(1);
+                _ierror._flags.corrupt = true;
+            }
+            return *this;
+        }
+
+    protected:
+        /**
+         * @brief Get the number of bytes of UTF-8 that fit in the input
+         * buffer.
+         *
+         * @returns The free space in the input buffer.
+         */
+        virtual size_t room() {
+            return _ibuf.epptr() - _ibuf.pptr();
+        }
+
+        /**
+         * @brief Append well-formed UTF-8 to the input buffer.
+         *
+         * @param[in] s The first byte.
+         * @param[in] n The number of bytes, which is no more than \ref room.
+         */
+        virtual void put(const char* s, size_t n) {
+            _ibuf.sputn(s, n);
+        }
+
+    private:
+        istream& _link;
+    };
+
+    /**
+     * @brief An input stream that validates the UTF-8 of another stream
+     * and delivers it as UTF-16.
+     *
+     * Each code unit is two bytes in the input buffer, in the byte order
+     * chosen at construction. Code points above U+FFFF become surrogate
+     * pairs.
+     *
+     * @attention \ref setbuf \em must be called before this class can
+     * be used.
+     */
+    class utf16_istream : public utf8_istream {
+    public:
+        /**
+         * @brief Constructor.
+         *
+         * @param[in] link The stream to read.
+         * @param[in] big_endian \c true for UTF-16BE, \c false for UTF-16LE.
+         */
+        explicit utf16_istream(istream& link, bool big_endian = false)
+            : utf8_istream(link), _big_endian(big_endian) {}
+
+    protected:
+        // no code point takes more than two bytes of UTF-16 per byte of UTF-8
+        virtual size_t room() {
+            return (_ibuf.epptr() - _ibuf.pptr()) / 2;
+        }
+
+        virtual void put(const char* s, size_t n) {
+            const unsigned char* u = (const unsigned char*) s;
+            char* out = _ibuf.pptr();
+            char* start = out;
+            size_t i = 0;
+            while (i < n) {
+#if defined(__SSSE3__)
+                if (i + 16 <= n) {
+                    __m128i in = _mm_loadu_si128((const __m128i*) (u + i));
+                    if (!_mm_movemask_epi8(in)) {
+                        // widen 16 ASCII bytes
+                        _mm_storeu_si128((__m128i*) out, widen(in, false));
+                        _mm_storeu_si128((__m128i*) (out + 16),
+                            widen(in, true));
+                        out += 32;
+                        i += 16;
+                        continue;
+                    }
+                }
+#endif
+                uint32_t cp = u[i];
+                if (cp < 0x80) {
+                    i += 1;
+                } else if (cp < 0xE0) {
+                    cp = (cp & 0x1F) << 6 | (u[i + 1] & 0x3F);
+                    i += 2;
+                } else if (cp < 0xF0) {
+                    cp = (cp & 0x0F) << 12 | (u[i + 1] & 0x3F) << 6
+                        | (u[i + 2] & 0x3F);
+                    i += 3;
+                } else {
+                    cp = (cp & 0x07) << 18 | (u[i + 1] & 0x3F) << 12
+                        | (u[i + 2] & 0x3F) << 6 | (u[i + 3] & 0x3F);
+                    i += 4;
+                }
+                if (cp >= 0x10000) {
+                    cp -= 0x10000;
+                    out = unit(out, 0xD800 | (cp >> 10));
+                    cp = 0xDC00 | (cp & 0x3FF);
+                }
+                out = unit(out, cp);
+            }
+            _ibuf.pbump(out - start);
+        }
+
+    private:
+#if defined(__SSSE3__)
+        // interleave the ASCII bytes with zero bytes in the stream's order
+        inline __m128i widen(__m128i in, bool high) const {
+            __m128i zero = _mm_setzero_si128();
+            if (_big_endian) {
+                return high ? _mm_unpackhi_epi8(zero, in)
+                    : _mm_unpacklo_epi8(zero, in);
+            }
+            return high ? _mm_unpackhi_epi8(in, zero)
+                : _mm_unpacklo_epi8(in, zero);
+        }
+#endif
+
+        inline char* unit(char* out, uint32_t u) const {
+            out[_big_endian ? 0 : 1] = (char) (u >> 8);
+            out[_big_endian ? 1 : 0] = (char) u;
+            return out + 2;
+        }
+
+        bool _big_endian;
+    };
+};
+
+#endif // UIO_UTF8_H